@@ -1,222 +1,851 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <atomic>
+#include <memory>
+#include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <saber/client/saber.h>
 #include <saber/util/countdownlatch.h>
-#include <saber/util/logging.h>
+#include <saber/util/metrics.h>
 #include <saber/util/timeops.h>
 #include <voyager/core/bg_eventloop.h>
-
-saber::CountDownLatch* g_latch = nullptr;
+#include <voyager/util/string_util.h>
 
 namespace saber {
 
-class ClientWatcher : public Watcher {
+enum OpType {
+  kGet = 0,
+  kSet,
+  kExists,
+  kChildren,
+  kCreate,
+  kDelete,
+  kEphemeral,
+  kOpTypes
+};
+
+static const char* kOpNames[kOpTypes] = {
+    "get", "set", "exists", "children", "create", "delete", "ephemeral"};
+
+struct BenchOptions {
+  BenchOptions()
+      : servers("127.0.0.1:6666"),
+        threads(4),
+        sessions(16),
+        roots(4),
+        keys(1000),
+        distribution("uniform"),
+        zipf_theta(0.99),
+        mix("get:90,set:10"),
+        value_sizes("100"),
+        depth(1),
+        arrival("constant"),
+        max_outstanding(10000),
+        warmup(1.0),
+        duration(10.0),
+        watchers(0),
+        seed(301) {}
+
+  bool Parse(int argc, char** argv);
+  void Print(FILE* f) const;
+  std::string ToJson() const;
+
+  // The style is host:port,host:port,...
+  std::string servers;
+  // The count of the event loops of the sessions.
+  int threads;
+  int sessions;
+  // The sessions are spread over the roots by the key distribution, and
+  // each root has keys nodes.
+  int roots;
+  int keys;
+  // "uniform" or "zipfian".
+  std::string distribution;
+  double zipf_theta;
+  // The weights of the operations, the style is op:weight,op:weight,...
+  std::string mix;
+  // Run one round for each value size, the style is size,size,...
+  std::string value_sizes;
+  // The requests kept outstanding by each session in the closed loop.
+  int depth;
+  // The offered loads (in requests per second of all the sessions) of the
+  // open loop, the style is rate,rate,... Run one round for each rate and
+  // each value size. Empty means the closed loop.
+  std::string rates;
+  // "constant" or "poisson", the arrivals of the open loop.
+  std::string arrival;
+  // The open loop does not send more if a session has max_outstanding
+  // requests outstanding, and counts the requests as unsent instead.
+  int max_outstanding;
+  // In seconds, the latencies of the warmup are not reported.
+  double warmup;
+  double duration;
+  // The sessions of each root which watch all the keys of the root.
+  int watchers;
+  uint64_t seed;
+  // The JSON report is written to it, or stdout if it is empty.
+  std::string output;
+
+  // Parsed from the strings above.
+  double weights[kOpTypes];
+  std::vector<size_t> sizes;
+  std::vector<double> loads;
+};
+
+static bool ParseMix(const std::string& mix, double* weights) {
+  for (int i = 0; i < kOpTypes; ++i) {
+    weights[i] = 0;
+  }
+  std::vector<std::string> items;
+  voyager::SplitStringUsing(mix, ",", &items);
+  double total = 0;
+  for (auto& item : items) {
+    size_t pos = item.find(':');
+    if (pos == std::string::npos) {
+      return false;
+    }
+    std::string name = item.substr(0, pos);
+    int i = 0;
+    while (i < kOpTypes && name != kOpNames[i]) {
+      ++i;
+    }
+    if (i == kOpTypes) {
+      return false;
+    }
+    weights[i] = atof(item.c_str() + pos + 1);
+    if (weights[i] < 0) {
+      return false;
+    }
+    total += weights[i];
+  }
+  return total > 0;
+}
+
+bool BenchOptions::Parse(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* eq = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || eq == nullptr) {
+      fprintf(stderr, "Invalid argument: %s\n", arg);
+      return false;
+    }
+    std::string name(arg + 2, eq);
+    const char* value = eq + 1;
+    if (name == "servers") {
+      servers = value;
+    } else if (name == "threads") {
+      threads = atoi(value);
+    } else if (name == "sessions") {
+      sessions = atoi(value);
+    } else if (name == "roots") {
+      roots = atoi(value);
+    } else if (name == "keys") {
+      keys = atoi(value);
+    } else if (name == "distribution") {
+      distribution = value;
+    } else if (name == "zipf_theta") {
+      zipf_theta = atof(value);
+    } else if (name == "mix") {
+      mix = value;
+    } else if (name == "value_sizes") {
+      value_sizes = value;
+    } else if (name == "depth") {
+      depth = atoi(value);
+    } else if (name == "rates") {
+      rates = value;
+    } else if (name == "arrival") {
+      arrival = value;
+    } else if (name == "max_outstanding") {
+      max_outstanding = atoi(value);
+    } else if (name == "warmup") {
+      warmup = atof(value);
+    } else if (name == "duration") {
+      duration = atof(value);
+    } else if (name == "watchers") {
+      watchers = atoi(value);
+    } else if (name == "seed") {
+      seed = strtoull(value, nullptr, 10);
+    } else if (name == "output") {
+      output = value;
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return false;
+    }
+  }
+  if (threads <= 0 || sessions <= 0 || roots <= 0 || keys <= 0 ||
+      depth <= 0 || max_outstanding <= 0 || duration <= 0 || warmup < 0 ||
+      watchers < 0) {
+    fprintf(stderr, "The counts and the duration must be positive.\n");
+    return false;
+  }
+  if (distribution != "uniform" && distribution != "zipfian") {
+    fprintf(stderr, "Unknown distribution: %s\n", distribution.c_str());
+    return false;
+  }
+  if (distribution == "zipfian" && (zipf_theta <= 0 || zipf_theta == 1)) {
+    fprintf(stderr, "The zipf_theta must be positive and not 1.\n");
+    return false;
+  }
+  if (!ParseMix(mix, weights)) {
+    fprintf(stderr, "Invalid mix: %s\n", mix.c_str());
+    return false;
+  }
+  if (arrival != "constant" && arrival != "poisson") {
+    fprintf(stderr, "Unknown arrival: %s\n", arrival.c_str());
+    return false;
+  }
+  std::vector<std::string> items;
+  voyager::SplitStringUsing(value_sizes, ",", &items);
+  for (auto& item : items) {
+    sizes.push_back(static_cast<size_t>(atoll(item.c_str())));
+  }
+  if (sizes.empty()) {
+    fprintf(stderr, "Invalid value_sizes: %s\n", value_sizes.c_str());
+    return false;
+  }
+  items.clear();
+  voyager::SplitStringUsing(rates, ",", &items);
+  for (auto& item : items) {
+    loads.push_back(atof(item.c_str()));
+    if (loads.back() <= 0) {
+      fprintf(stderr, "Invalid rates: %s\n", rates.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+void BenchOptions::Print(FILE* f) const {
+  BenchOptions d;
+  fprintf(f, "Usage: bench [--name=value ...]\n");
+  fprintf(f, "  --servers=%s\n", d.servers.c_str());
+  fprintf(f, "  --threads=%d\n", d.threads);
+  fprintf(f, "  --sessions=%d\n", d.sessions);
+  fprintf(f, "  --roots=%d\n", d.roots);
+  fprintf(f, "  --keys=%d           (per root)\n", d.keys);
+  fprintf(f, "  --distribution=%s  (uniform or zipfian)\n",
+          d.distribution.c_str());
+  fprintf(f, "  --zipf_theta=%.2f\n", d.zipf_theta);
+  fprintf(f, "  --mix=%s  (ops: get set exists children create delete "
+             "ephemeral)\n", d.mix.c_str());
+  fprintf(f, "  --value_sizes=%s     (one round per size)\n",
+          d.value_sizes.c_str());
+  fprintf(f, "  --depth=%d            (outstanding requests per session)\n",
+          d.depth);
+  fprintf(f, "  --rates=             (the open loop, requests per second)\n");
+  fprintf(f, "  --arrival=%s    (constant or poisson)\n",
+          d.arrival.c_str());
+  fprintf(f, "  --max_outstanding=%d\n", d.max_outstanding);
+  fprintf(f, "  --warmup=%.1f        (seconds)\n", d.warmup);
+  fprintf(f, "  --duration=%.1f     (seconds per round)\n", d.duration);
+  fprintf(f, "  --watchers=%d         (watching sessions per root)\n",
+          d.watchers);
+  fprintf(f, "  --seed=%llu\n", static_cast<unsigned long long>(d.seed));
+  fprintf(f, "  --output=            (the JSON report, stdout by default)\n");
+}
+
+std::string BenchOptions::ToJson() const {
+  char buf[1024];
+  snprintf(buf, sizeof(buf),
+           "{\"servers\":\"%s\",\"threads\":%d,\"sessions\":%d,\"roots\":%d,"
+           "\"keys\":%d,\"distribution\":\"%s\",\"zipf_theta\":%.3f,"
+           "\"mix\":\"%s\",\"value_sizes\":\"%s\",\"depth\":%d,"
+           "\"rates\":\"%s\",\"arrival\":\"%s\",\"max_outstanding\":%d,"
+           "\"warmup\":%.3f,\"duration\":%.3f,\"watchers\":%d,\"seed\":%llu}",
+           servers.c_str(), threads, sessions, roots, keys,
+           distribution.c_str(), zipf_theta, mix.c_str(), value_sizes.c_str(),
+           depth, rates.c_str(), arrival.c_str(), max_outstanding, warmup,
+           duration, watchers,
+           static_cast<unsigned long long>(seed));
+  return buf;
+}
+
+// Generate the numbers in [0, n) uniformly, or by the zipfian distribution
+// as YCSB does, in which 0 is the most popular one.
+class KeyGenerator {
  public:
-  virtual void Process(const WatchedEvent& event) {
-    if (event.type() == ET_NONE) {
-      std::string s;
-      switch (event.state()) {
-        case SS_CONNECTING:
-          s = "Connecting";
-          break;
-        case SS_CONNECTED:
-          s = "Connected";
-          break;
-        case SS_DISCONNECTED:
-          s = "Disconnected";
-          break;
-        case SS_EXPIRED:
-          s = "Expired";
-          break;
-        case SS_AUTHFAILED:
-          s = "AuthFailed";
-          break;
-        default:
-          s = "Unknown";
-          assert(false);
-          break;
-      }
-      printf("Session state: %s\n", s.c_str());
+  KeyGenerator(uint64_t n, bool zipfian, double theta)
+      : n_(n), zipfian_(zipfian && n > 1), theta_(theta), uniform_(0, n - 1) {
+    if (zipfian_) {
+      zetan_ = Zeta(n, theta);
+      double zeta2 = Zeta(2, theta);
+      alpha_ = 1.0 / (1.0 - theta);
+      eta_ = (1.0 - pow(2.0 / static_cast<double>(n), 1.0 - theta)) /
+             (1.0 - zeta2 / zetan_);
+    }
+  }
+
+  uint64_t Next(std::mt19937_64* rng) {
+    if (!zipfian_) {
+      return uniform_(*rng);
+    }
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(*rng);
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + pow(0.5, theta_)) {
+      return 1;
+    }
+    uint64_t i = static_cast<uint64_t>(static_cast<double>(n_) *
+                                       pow(eta_ * u - eta_ + 1.0, alpha_));
+    return i < n_ ? i : n_ - 1;
+  }
+
+ private:
+  static double Zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 1; i <= n; ++i) {
+      sum += 1.0 / pow(static_cast<double>(i), theta);
     }
+    return sum;
   }
+
+  const uint64_t n_;
+  const bool zipfian_;
+  const double theta_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+  std::uniform_int_distribution<uint64_t> uniform_;
 };
 
-class Client {
+// The latencies and the counts of one round, or of the warmup.
+struct Phase {
+  Phase() : notifications(0), unsent(0) {
+    for (int i = 0; i < kOpTypes; ++i) {
+      errors[i] = 0;
+    }
+  }
+
+  Histogram latency[kOpTypes];
+  Histogram all;
+  // How late the open loop sent the requests.
+  Histogram send_lag;
+  std::atomic<uint64_t> errors[kOpTypes];
+  std::atomic<uint64_t> notifications;
+  std::atomic<uint64_t> unsent;
+};
+
+static std::atomic<Phase*> g_phase(nullptr);
+static std::atomic<bool> g_running(false);
+static std::atomic<int> g_outstanding(0);
+
+// The paths of the keys of each root, which are shared by the sessions.
+static std::vector<std::string> g_roots;
+static std::vector<std::vector<std::string>> g_keys;
+
+static bool IsOk(ResponseCode code) {
+  return code == RC_OK || code == RC_NO_NODE || code == RC_NODE_EXISTS;
+}
+
+// Create the root and its keys with depth requests outstanding.
+class Loader {
  public:
-  Client(voyager::EventLoop* loop, const ClientOptions& options,
-         int write_times, int read_times)
-      : write_times_(write_times),
-        read_times_(read_times),
-        finish_(0),
-        start_(0),
-        end_(0),
-        loop_(loop),
-        client_(loop, options),
-        path_(options.root) {}
+  Loader(voyager::EventLoop* loop, const ClientOptions& options, int root,
+         const std::string& value, CountDownLatch* latch)
+      : client_(loop, options),
+        root_(root),
+        value_(value),
+        latch_(latch),
+        next_(0),
+        finished_(0) {}
 
   void Start() {
     client_.Connect();
-    Create();
+    CreateRequest request;
+    request.set_path(g_roots[root_]);
+    client_.Create(request, nullptr,
+                   [this](const std::string& path, void*,
+                          const CreateResponse& response) {
+                     if (!IsOk(response.code())) {
+                       fprintf(stderr, "Create %s failed: %d\n", path.c_str(),
+                               response.code());
+                       exit(1);
+                     }
+                     for (int i = 0; i < 128; ++i) {
+                       CreateNext();
+                     }
+                   });
   }
 
   void Stop() { client_.Close(); }
 
-  void Create() {
+ private:
+  void CreateNext() {
+    const std::vector<std::string>& keys = g_keys[root_];
+    if (next_ == keys.size()) {
+      return;
+    }
     CreateRequest request;
-    request.set_path(path_);
-    request.set_data("lock service");
+    request.set_path(keys[next_++]);
+    request.set_data(value_);
     client_.Create(request, nullptr,
-                   std::bind(&Client::OnCreate, this, std::placeholders::_1,
-                             std::placeholders::_2, std::placeholders::_3));
+                   [this, &keys](const std::string& path, void*,
+                                 const CreateResponse& response) {
+                     if (!IsOk(response.code())) {
+                       fprintf(stderr, "Create %s failed: %d\n", path.c_str(),
+                               response.code());
+                       exit(1);
+                     }
+                     if (++finished_ == keys.size()) {
+                       latch_->CountDown();
+                     } else {
+                       CreateNext();
+                     }
+                   });
   }
 
-  void OnCreate(const std::string& path, void* context,
-                const CreateResponse& response) {
-    if (response.code() == RC_OK || response.code() == RC_NODE_EXISTS) {
-      printf("create successful, begin to test!\n");
-      g_latch->CountDown();
-    } else {
-      printf("create failed!\n");
-      exit(0);
+  Saber client_;
+  const int root_;
+  const std::string value_;
+  CountDownLatch* latch_;
+  size_t next_;
+  size_t finished_;
+
+  // No copying allowed
+  Loader(const Loader&);
+  void operator=(const Loader&);
+};
+
+// Watch all the keys of the root, and watch them again once triggered.
+class WatchSession : public Watcher {
+ public:
+  WatchSession(voyager::EventLoop* loop, const ClientOptions& options,
+               int root)
+      : client_(loop, options), root_(root) {}
+
+  void Start() {
+    client_.Connect();
+    for (auto& key : g_keys[root_]) {
+      Watch(key);
     }
   }
 
-  void GetData() { loop_->RunInLoop(std::bind(&Client::GetDataInLoop, this)); }
+  void Stop() { client_.Close(); }
 
-  void GetDataInLoop() {
-    start_ = NowMicros();
-    GetDataRequest request;
-    request.set_path(path_);
-    request.set_watch(false);
-    for (int i = 0; i < read_times_; ++i) {
-      client_.GetData(request, nullptr, nullptr,
-                      std::bind(&Client::OnGetData, this, std::placeholders::_1,
-                                std::placeholders::_2, std::placeholders::_3));
+  virtual void Process(const WatchedEvent& event) {
+    if (event.type() == ET_NONE) {
+      return;
+    }
+    g_phase.load()->notifications.fetch_add(1, std::memory_order_relaxed);
+    if (event.type() == ET_RESYNC) {
+      for (auto& key : g_keys[root_]) {
+        Watch(key);
+      }
+    } else {
+      Watch(event.path());
     }
   }
 
-  void OnGetData(const std::string& path, void* context,
-                 const GetDataResponse& response) {
-    ++finish_;
-    // printf("Read finish:%d\n", finish_);
-    if (finish_ == read_times_) {
-      end_ = NowMicros();
-      double time = (double)(end_ - start_) / 1000000;
-      printf("Read Time: %f, TPS:%f\n", time, read_times_ / time);
-      g_latch->CountDown();
-      finish_ = 0;
+ private:
+  void Watch(const std::string& path) {
+    ExistsRequest request;
+    request.set_path(path);
+    request.set_watch(true);
+    client_.Exists(request, this, nullptr,
+                   [](const std::string&, void*, const ExistsResponse&) {});
+  }
+
+  Saber client_;
+  const int root_;
+
+  // No copying allowed
+  WatchSession(const WatchSession&);
+  void operator=(const WatchSession&);
+};
+
+// Send the requests of the mix while g_running is true. In the closed loop
+// it keeps depth requests outstanding. In the open loop it sends them at
+// the rate whether or not the earlier ones were replied, and the latencies
+// are measured from when they should have been sent, so that the queueing
+// delay of an overloaded cluster is not hidden by the client waiting.
+class Session {
+ public:
+  Session(voyager::EventLoop* loop, const ClientOptions& options,
+          const BenchOptions& bench, int root, uint64_t seed)
+      : loop_(loop),
+        client_(loop, options),
+        bench_(bench),
+        root_(root),
+        rng_(seed),
+        ops_(bench.weights, bench.weights + kOpTypes),
+        keys_(static_cast<uint64_t>(bench.keys),
+              bench.distribution == "zipfian", bench.zipf_theta),
+        value_(nullptr),
+        interval_(0),
+        next_(0),
+        outstanding_(0),
+        round_(0) {}
+
+  void Start() { client_.Connect(); }
+  void Stop() { client_.Close(); }
+
+  // The rate is in requests per second of this session, zero means the
+  // closed loop.
+  void Run(const std::string* value, double rate) {
+    loop_->RunInLoop([this, value, rate]() {
+      value_ = value;
+      ++round_;
+      if (rate > 0) {
+        interval_ = 1e6 / rate;
+        next_ = static_cast<double>(NowMonotonicMicros());
+        Tick(round_);
+      } else {
+        interval_ = 0;
+        for (int i = 0; i < bench_.depth; ++i) {
+          Issue(NowMonotonicMicros());
+        }
+      }
+    });
+  }
+
+ private:
+  // The timers of the loop fire late by up to a few milliseconds, so send
+  // all the requests which are due, each with its own intended send time.
+  void Tick(uint64_t round) {
+    // The timer of the last round may fire after this round started.
+    if (round != round_ || !g_running.load(std::memory_order_relaxed)) {
+      return;
     }
+    uint64_t now = NowMonotonicMicros();
+    while (next_ <= static_cast<double>(now)) {
+      uint64_t start = static_cast<uint64_t>(next_);
+      Phase* phase = g_phase.load(std::memory_order_acquire);
+      phase->send_lag.Record(now - start);
+      if (outstanding_ < bench_.max_outstanding) {
+        Issue(start);
+      } else {
+        phase->unsent.fetch_add(1, std::memory_order_relaxed);
+      }
+      next_ += NextInterval();
+    }
+    loop_->RunAfter(static_cast<uint64_t>(next_) - now,
+                    [this, round]() { Tick(round); });
   }
 
-  void SetData() { loop_->RunInLoop(std::bind(&Client::SetDataInLoop, this)); }
+  double NextInterval() {
+    if (bench_.arrival == "poisson") {
+      return std::exponential_distribution<double>(1.0 / interval_)(rng_);
+    }
+    return interval_;
+  }
 
-  void SetDataInLoop() {
-    start_ = NowMicros();
-    SetDataRequest request;
-    request.set_path(path_);
-    request.set_data("lock service");
-    request.set_version(-1);
-    for (int i = 0; i < write_times_; ++i) {
-      client_.SetData(request, nullptr,
-                      std::bind(&Client::OnSetData, this, std::placeholders::_1,
-                                std::placeholders::_2, std::placeholders::_3));
+  void Issue(uint64_t start) {
+    if (!g_running.load(std::memory_order_relaxed)) {
+      return;
+    }
+    ++outstanding_;
+    g_outstanding.fetch_add(1, std::memory_order_relaxed);
+    OpType type = static_cast<OpType>(ops_(rng_));
+    const std::string& key = g_keys[root_][keys_.Next(&rng_)];
+    switch (type) {
+      case kGet: {
+        GetDataRequest request;
+        request.set_path(key);
+        client_.GetData(request, nullptr, nullptr,
+                        [this, start](const std::string&, void*,
+                                      const GetDataResponse& response) {
+                          Done(kGet, start, response.code());
+                        });
+        break;
+      }
+      case kSet: {
+        SetDataRequest request;
+        request.set_path(key);
+        request.set_data(*value_);
+        request.set_version(-1);
+        client_.SetData(request, nullptr,
+                        [this, start](const std::string&, void*,
+                                      const SetDataResponse& response) {
+                          Done(kSet, start, response.code());
+                        });
+        break;
+      }
+      case kExists: {
+        ExistsRequest request;
+        request.set_path(key);
+        client_.Exists(request, nullptr, nullptr,
+                       [this, start](const std::string&, void*,
+                                     const ExistsResponse& response) {
+                         Done(kExists, start, response.code());
+                       });
+        break;
+      }
+      case kChildren: {
+        GetChildrenRequest request;
+        request.set_path(g_roots[root_]);
+        client_.GetChildren(request, nullptr, nullptr,
+                            [this, start](const std::string&, void*,
+                                          const GetChildrenResponse& response) {
+                              Done(kChildren, start, response.code());
+                            });
+        break;
+      }
+      case kCreate: {
+        CreateRequest request;
+        request.set_path(key);
+        request.set_data(*value_);
+        client_.Create(request, nullptr,
+                       [this, start](const std::string&, void*,
+                                     const CreateResponse& response) {
+                         Done(kCreate, start, response.code());
+                       });
+        break;
+      }
+      case kDelete: {
+        DeleteRequest request;
+        request.set_path(key);
+        request.set_version(-1);
+        client_.Delete(request, nullptr,
+                       [this, start](const std::string&, void*,
+                                     const DeleteResponse& response) {
+                         Done(kDelete, start, response.code());
+                       });
+        break;
+      }
+      case kEphemeral: {
+        CreateRequest request;
+        request.set_path(g_roots[root_] + "/e-");
+        request.set_data(*value_);
+        request.set_type(NT_EPHEMERAL_SEQUENTIAL);
+        client_.Create(request, nullptr,
+                       [this, start](const std::string&, void*,
+                                     const CreateResponse& response) {
+                         Done(kEphemeral, start, response.code());
+                       });
+        break;
+      }
+      default: {
+        assert(false);
+        break;
+      }
     }
   }
 
-  void OnSetData(const std::string& path, void* context,
-                 const SetDataResponse& response) {
-    ++finish_;
-    // printf("Write finish:%d\n", finish_);
-    if (finish_ == write_times_) {
-      end_ = NowMicros();
-      double time = (double)(end_ - start_) / 1000000;
-      printf("Write Time: %f, TPS:%f\n", time, write_times_ / time);
-      g_latch->CountDown();
-      finish_ = 0;
+  void Done(OpType type, uint64_t start, ResponseCode code) {
+    uint64_t micros = NowMonotonicMicros() - start;
+    Phase* phase = g_phase.load(std::memory_order_acquire);
+    phase->latency[type].Record(micros);
+    phase->all.Record(micros);
+    if (!IsOk(code)) {
+      phase->errors[type].fetch_add(1, std::memory_order_relaxed);
+    }
+    --outstanding_;
+    g_outstanding.fetch_sub(1, std::memory_order_relaxed);
+    if (interval_ == 0) {
+      Issue(NowMonotonicMicros());
     }
   }
 
- private:
-  int write_times_;
-  int read_times_;
-  int finish_;
-  uint64_t start_;
-  uint64_t end_;
   voyager::EventLoop* loop_;
   Saber client_;
-  std::string path_;
+  const BenchOptions& bench_;
+  const int root_;
+  std::mt19937_64 rng_;
+  std::discrete_distribution<int> ops_;
+  KeyGenerator keys_;
+  const std::string* value_;
+  // In microseconds, the mean interval between the requests and the
+  // intended send time of the next one in the open loop.
+  double interval_;
+  double next_;
+  int outstanding_;
+  uint64_t round_;
 
-  Client(const Client&);
-  void operator=(const Client&);
+  // No copying allowed
+  Session(const Session&);
+  void operator=(const Session&);
 };
 
+static void AppendLatency(const char* name, const Histogram& histogram,
+                          std::string* s) {
+  HistogramSnapshot h;
+  histogram.GetSnapshot(&h);
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p99\":%llu,"
+           "\"p999\":%llu,\"max\":%llu}",
+           name, static_cast<unsigned long long>(h.count), h.Mean(),
+           static_cast<unsigned long long>(h.p50),
+           static_cast<unsigned long long>(h.p99),
+           static_cast<unsigned long long>(h.p999),
+           static_cast<unsigned long long>(h.max));
+  s->append(buf);
+}
+
+// The report of one round, the latencies are in microseconds.
+static std::string PhaseToJson(const Phase& phase, size_t value_size,
+                               double rate, double seconds) {
+  HistogramSnapshot all;
+  phase.all.GetSnapshot(&all);
+  uint64_t errors = 0;
+  for (int i = 0; i < kOpTypes; ++i) {
+    errors += phase.errors[i].load();
+  }
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "{\"value_size\":%zu,\"mode\":\"%s\",\"offered\":%.1f,"
+           "\"seconds\":%.3f,\"ops\":%llu,\"errors\":%llu,\"unsent\":%llu,"
+           "\"throughput\":%.1f,\"notifications\":%llu,",
+           value_size, rate > 0 ? "open" : "closed", rate, seconds,
+           static_cast<unsigned long long>(all.count),
+           static_cast<unsigned long long>(errors),
+           static_cast<unsigned long long>(phase.unsent.load()),
+           static_cast<double>(all.count) / seconds,
+           static_cast<unsigned long long>(phase.notifications.load()));
+  std::string s(buf);
+  AppendLatency("send_lag_us", phase.send_lag, &s);
+  s.append(",\"latency_us\":{");
+  AppendLatency("all", phase.all, &s);
+  for (int i = 0; i < kOpTypes; ++i) {
+    s.push_back(',');
+    AppendLatency(kOpNames[i], phase.latency[i], &s);
+  }
+  s.append("}}");
+  return s;
+}
+
 }  // namespace saber
 
 int main(int argc, char** argv) {
-  if (argc != 5) {
-    printf(
-        "Usage: <%s> <server_ip:server_port,...> <concurrent> <write_times> "
-        "<read_times>\n",
-        argv[0]);
+  saber::BenchOptions bench;
+  if (!bench.Parse(argc, argv)) {
+    bench.Print(stderr);
     return -1;
   }
-
-  // saber::SetLogHandler(nullptr);
-  // saber::SetLogLevel(saber::LOGLEVEL_DEBUG);
-  saber::ClientWatcher watcher;
   saber::ClientOptions options;
-  // options.root = "/ls";
-  options.servers = argv[1];
-  // options.watcher = &watcher;
-
-  int c = std::stoi(argv[2]);
-  int write_times = std::stoi(argv[3]);
-  int read_times = std::stoi(argv[4]);
-
-  g_latch = new saber::CountDownLatch(c);
-  std::vector<voyager::BGEventLoop> threads(c);
-  std::vector<std::unique_ptr<saber::Client>> clients;
-  for (int i = 0; i < c; ++i) {
-    options.root = "/ls-" + std::to_string(i);
-    clients.push_back(std::unique_ptr<saber::Client>(new saber::Client(
-        threads[i].Loop(), options, write_times, read_times)));
-    clients[i]->Start();
-  }
-  g_latch->Wait();
-  printf("All create successful, begin to test!\n");
-  delete g_latch;
-
-  g_latch = new saber::CountDownLatch(c);
-  uint64_t start = saber::NowMicros();
-  for (int i = 0; i < c; ++i) {
-    clients[i]->SetData();
-  }
-  g_latch->Wait();
-  uint64_t end = saber::NowMicros();
-  double time = (double)(end - start) / 1000000;
-  printf("All Write Time:%f, TPS:%f\n", time, c * write_times / time);
-  delete g_latch;
-
-  saber::SleepForMicroseconds(1000000);
-
-  g_latch = new saber::CountDownLatch(c);
-  start = saber::NowMicros();
-  for (int i = 0; i < c; ++i) {
-    clients[i]->GetData();
-  }
-  g_latch->Wait();
-  end = saber::NowMicros();
-  time = (double)(end - start) / 1000000;
-  printf("All Read Time:%f, TPS:%f\n", time, c * read_times / time);
-  delete g_latch;
-
-  for (int i = 0; i < c; ++i) {
-    clients[i]->Stop();
+  options.servers = bench.servers;
+
+  std::mt19937_64 rng(bench.seed);
+  for (int i = 0; i < bench.roots; ++i) {
+    saber::g_roots.push_back("/bench-" + std::to_string(i));
+    std::vector<std::string> keys;
+    for (int j = 0; j < bench.keys; ++j) {
+      keys.push_back(saber::g_roots[i] + "/k" + std::to_string(j));
+    }
+    saber::g_keys.push_back(keys);
+  }
+
+  std::vector<voyager::BGEventLoop> threads(bench.threads);
+  std::vector<voyager::EventLoop*> loops;
+  for (auto& thread : threads) {
+    loops.push_back(thread.Loop());
+  }
+
+  // Keep the warmup phase until the first round starts.
+  std::vector<std::unique_ptr<saber::Phase>> phases;
+  phases.push_back(std::unique_ptr<saber::Phase>(new saber::Phase()));
+  saber::g_phase = phases.back().get();
+
+  std::string value(bench.sizes.front(), 'v');
+  saber::CountDownLatch latch(bench.roots);
+  std::vector<std::unique_ptr<saber::Loader>> loaders;
+  for (int i = 0; i < bench.roots; ++i) {
+    options.root = saber::g_roots[i];
+    loaders.push_back(std::unique_ptr<saber::Loader>(
+        new saber::Loader(loops[i % loops.size()], options, i, value, &latch)));
+    loaders.back()->Start();
+  }
+  latch.Wait();
+  fprintf(stderr, "Created %d roots of %d keys.\n", bench.roots, bench.keys);
+
+  // The sessions are spread over the roots by the distribution too.
+  saber::KeyGenerator roots(static_cast<uint64_t>(bench.roots),
+                            bench.distribution == "zipfian", bench.zipf_theta);
+  std::vector<std::unique_ptr<saber::Session>> sessions;
+  for (int i = 0; i < bench.sessions; ++i) {
+    int root = static_cast<int>(roots.Next(&rng));
+    options.root = saber::g_roots[root];
+    sessions.push_back(std::unique_ptr<saber::Session>(new saber::Session(
+        loops[i % loops.size()], options, bench, root, rng())));
+    sessions.back()->Start();
+  }
+  std::vector<std::unique_ptr<saber::WatchSession>> watchers;
+  for (int i = 0; i < bench.roots; ++i) {
+    options.root = saber::g_roots[i];
+    for (int j = 0; j < bench.watchers; ++j) {
+      watchers.push_back(std::unique_ptr<saber::WatchSession>(
+          new saber::WatchSession(loops[watchers.size() % loops.size()],
+                                  options, i)));
+      watchers.back()->Start();
+    }
+  }
+
+  // The closed loop runs one round for each value size, and the open loop
+  // runs one round for each pair of value size and rate.
+  std::vector<std::pair<size_t, double>> rounds;
+  for (size_t size : bench.sizes) {
+    if (bench.loads.empty()) {
+      rounds.push_back(std::make_pair(size, 0.0));
+    }
+    for (double rate : bench.loads) {
+      rounds.push_back(std::make_pair(size, rate));
+    }
+  }
+
+  std::string report = "{\"config\":" + bench.ToJson() + ",\"results\":[";
+  for (size_t i = 0; i < rounds.size(); ++i) {
+    value.assign(rounds[i].first, 'v');
+    saber::g_running = true;
+    for (auto& session : sessions) {
+      session->Run(&value, rounds[i].second / bench.sessions);
+    }
+    saber::SleepForMicroseconds(static_cast<int>(bench.warmup * 1e6));
+
+    phases.push_back(std::unique_ptr<saber::Phase>(new saber::Phase()));
+    saber::g_phase = phases.back().get();
+    uint64_t start = saber::NowMonotonicMicros();
+    saber::SleepForMicroseconds(static_cast<int>(bench.duration * 1e6));
+    saber::g_running = false;
+    double seconds =
+        static_cast<double>(saber::NowMonotonicMicros() - start) / 1e6;
+    while (saber::g_outstanding.load() > 0) {
+      saber::SleepForMicroseconds(1000);
+    }
+
+    std::string result =
+        saber::PhaseToJson(*phases.back(), rounds[i].first, rounds[i].second,
+                           seconds);
+    fprintf(stderr, "%s\n", result.c_str());
+    if (i != 0) {
+      report.push_back(',');
+    }
+    report.append(result);
+
+    // The requests completed between the rounds go to the next warmup.
+    phases.push_back(std::unique_ptr<saber::Phase>(new saber::Phase()));
+    saber::g_phase = phases.back().get();
   }
+  report.append("]}\n");
 
+  FILE* f = bench.output.empty() ? stdout : fopen(bench.output.c_str(), "w");
+  if (f == nullptr) {
+    fprintf(stderr, "Open %s failed.\n", bench.output.c_str());
+    return -1;
+  }
+  fputs(report.c_str(), f);
+  if (f != stdout) {
+    fclose(f);
+  }
+
+  for (auto& session : sessions) {
+    session->Stop();
+  }
+  for (auto& watcher : watchers) {
+    watcher->Stop();
+  }
+  for (auto& loader : loaders) {
+    loader->Stop();
+  }
+  saber::SleepForMicroseconds(100000);
   return 0;
 }
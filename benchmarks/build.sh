@@ -1,5 +1,5 @@
 #!/bin/sh
 
-for i in $(seq 1 100); do
-  ../build/release/bin/bench 127.0.0.1:6666,127.0.0.1:6667,127.0.0.1:6668 10 1000 10000
-done
+../build/release/bin/bench --servers=127.0.0.1:6666,127.0.0.1:6667,127.0.0.1:6668 \
+  --threads=10 --sessions=100 --mix=set:100 --duration=10 \
+  --output=bench.json
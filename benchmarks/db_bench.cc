@@ -0,0 +1,668 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <voyager/util/string_util.h>
+
+#include "saber/proto/saber.pb.h"
+#include "saber/proto/server.pb.h"
+#include "saber/server/data_tree.h"
+#include "saber/server/saber_db.h"
+#include "saber/server/server_options.h"
+#include "saber/service/watcher.h"
+#include "saber/util/countdownlatch.h"
+#include "saber/util/metrics.h"
+#include "saber/util/runloop_thread.h"
+#include "saber/util/timeops.h"
+
+namespace saber {
+
+static const char* kAllBenchmarks =
+    "create,getdata,getdata_watch,setdata,setdata_watch,getchildren,"
+    "killsession,checkpoint,execute,delete";
+
+struct DBBenchOptions {
+  DBBenchOptions()
+      : sizes("1000,10000,100000,1000000"),
+        threads("1,4"),
+        benchmarks(kAllBenchmarks),
+        fanout(1000),
+        value_size(100),
+        ops(1000000),
+        ephemerals(10),
+        seed(301) {}
+
+  bool Parse(int argc, char** argv);
+  void Print(FILE* f) const;
+  std::string ToJson() const;
+  bool Has(const std::string& name) const;
+
+  // The node counts of the trees, the style is count,count,...
+  std::string sizes;
+  // The thread counts, the style is count,count,...
+  std::string threads;
+  // The style is name,name,...
+  std::string benchmarks;
+  // The nodes are spread over the directories of fanout nodes each.
+  int fanout;
+  int value_size;
+  // The operations of each read or update benchmark, of all the threads.
+  int ops;
+  // The ephemeral nodes of each session killed.
+  int ephemerals;
+  uint64_t seed;
+  // The JSON report is written to it, or stdout if it is empty.
+  std::string output;
+
+  // Parsed from the strings above.
+  std::vector<uint64_t> node_counts;
+  std::vector<int> thread_counts;
+  std::vector<std::string> names;
+};
+
+bool DBBenchOptions::Parse(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* eq = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || eq == nullptr) {
+      fprintf(stderr, "Invalid argument: %s\n", arg);
+      return false;
+    }
+    std::string name(arg + 2, eq);
+    const char* value = eq + 1;
+    if (name == "sizes") {
+      sizes = value;
+    } else if (name == "threads") {
+      threads = value;
+    } else if (name == "benchmarks") {
+      benchmarks = value;
+    } else if (name == "fanout") {
+      fanout = atoi(value);
+    } else if (name == "value_size") {
+      value_size = atoi(value);
+    } else if (name == "ops") {
+      ops = atoi(value);
+    } else if (name == "ephemerals") {
+      ephemerals = atoi(value);
+    } else if (name == "seed") {
+      seed = strtoull(value, nullptr, 10);
+    } else if (name == "output") {
+      output = value;
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return false;
+    }
+  }
+  if (fanout <= 0 || value_size < 0 || ops <= 0 || ephemerals <= 0) {
+    fprintf(stderr, "The counts must be positive.\n");
+    return false;
+  }
+  std::vector<std::string> items;
+  voyager::SplitStringUsing(sizes, ",", &items);
+  for (auto& item : items) {
+    node_counts.push_back(strtoull(item.c_str(), nullptr, 10));
+    if (node_counts.back() == 0) {
+      fprintf(stderr, "Invalid sizes: %s\n", sizes.c_str());
+      return false;
+    }
+  }
+  items.clear();
+  voyager::SplitStringUsing(threads, ",", &items);
+  for (auto& item : items) {
+    thread_counts.push_back(atoi(item.c_str()));
+    if (thread_counts.back() <= 0) {
+      fprintf(stderr, "Invalid threads: %s\n", threads.c_str());
+      return false;
+    }
+  }
+  voyager::SplitStringUsing(benchmarks, ",", &names);
+  std::string all = std::string(",") + kAllBenchmarks + ",";
+  for (auto& name : names) {
+    if (all.find("," + name + ",") == std::string::npos) {
+      fprintf(stderr, "Unknown benchmark: %s\n", name.c_str());
+      return false;
+    }
+  }
+  if (node_counts.empty() || thread_counts.empty() || names.empty()) {
+    fprintf(stderr, "The sizes, threads and benchmarks must not be empty.\n");
+    return false;
+  }
+  return true;
+}
+
+void DBBenchOptions::Print(FILE* f) const {
+  DBBenchOptions d;
+  fprintf(f, "Usage: db_bench [--name=value ...]\n");
+  fprintf(f, "  --sizes=%s  (nodes of the tree, up to 10000000)\n",
+          d.sizes.c_str());
+  fprintf(f, "  --threads=%s\n", d.threads.c_str());
+  fprintf(f, "  --benchmarks=%s\n", d.benchmarks.c_str());
+  fprintf(f, "  --fanout=%d      (nodes of each directory)\n", d.fanout);
+  fprintf(f, "  --value_size=%d\n", d.value_size);
+  fprintf(f, "  --ops=%d      (operations of each read or update benchmark)\n",
+          d.ops);
+  fprintf(f, "  --ephemerals=%d    (ephemeral nodes of each session killed)\n",
+          d.ephemerals);
+  fprintf(f, "  --seed=%llu\n", static_cast<unsigned long long>(d.seed));
+  fprintf(f, "  --output=         (the JSON report, stdout by default)\n");
+}
+
+std::string DBBenchOptions::ToJson() const {
+  char buf[1024];
+  snprintf(buf, sizeof(buf),
+           "{\"sizes\":\"%s\",\"threads\":\"%s\",\"benchmarks\":\"%s\","
+           "\"fanout\":%d,\"value_size\":%d,\"ops\":%d,\"ephemerals\":%d,"
+           "\"seed\":%llu}",
+           sizes.c_str(), threads.c_str(), benchmarks.c_str(), fanout,
+           value_size, ops, ephemerals, static_cast<unsigned long long>(seed));
+  return buf;
+}
+
+bool DBBenchOptions::Has(const std::string& name) const {
+  for (auto& n : names) {
+    if (n == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+class CountingWatcher : public Watcher {
+ public:
+  CountingWatcher() : count_(0) {}
+
+  virtual void Process(const WatchedEvent& event) { ++count_; }
+
+  uint64_t count() const { return count_.load(); }
+
+ private:
+  std::atomic<uint64_t> count_;
+
+  // No copying allowed
+  CountingWatcher(const CountingWatcher&);
+  void operator=(const CountingWatcher&);
+};
+
+static const char* kRoot = "/db-bench";
+
+static uint64_t NowNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// The latencies are in nanoseconds.
+struct Result {
+  Result(const std::string& n, uint64_t nodes_count, int threads_count)
+      : name(n), nodes(nodes_count), threads(threads_count), seconds(0),
+        bytes(0) {}
+
+  std::string ToJson() const;
+
+  std::string name;
+  uint64_t nodes;
+  int threads;
+  double seconds;
+  uint64_t bytes;
+  Histogram latency;
+
+  // No copying allowed
+  Result(const Result&);
+  void operator=(const Result&);
+};
+
+std::string Result::ToJson() const {
+  HistogramSnapshot h;
+  latency.GetSnapshot(&h);
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "{\"benchmark\":\"%s\",\"nodes\":%llu,\"threads\":%d,\"ops\":%llu,"
+           "\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"bytes\":%llu,"
+           "\"latency_ns\":{\"mean\":%.1f,\"p50\":%llu,\"p99\":%llu,"
+           "\"p999\":%llu,\"max\":%llu}}",
+           name.c_str(), static_cast<unsigned long long>(nodes), threads,
+           static_cast<unsigned long long>(h.count), seconds,
+           seconds > 0 ? static_cast<double>(h.count) / seconds : 0.0,
+           static_cast<unsigned long long>(bytes), h.Mean(),
+           static_cast<unsigned long long>(h.p50),
+           static_cast<unsigned long long>(h.p99),
+           static_cast<unsigned long long>(h.p999),
+           static_cast<unsigned long long>(h.max));
+  return buf;
+}
+
+class DBBench {
+ public:
+  explicit DBBench(const DBBenchOptions& options);
+
+  // Run the benchmarks on a tree of the nodes, by the threads.
+  void Run(uint64_t nodes, int threads, bool first);
+
+  std::string ToJson() const;
+
+ private:
+  typedef std::function<void(int thread, uint64_t i, std::mt19937_64* rng,
+                             Result* result)> OpFunc;
+
+  // Run the ops by the threads, the thread t runs the ops t, t + threads,
+  // and so on. The op records its latency into the result, so that the
+  // work around the op such as formatting its path is not counted.
+  void RunParallel(Result* result, int threads, uint64_t ops,
+                   const OpFunc& op);
+
+  Result* NewResult(const std::string& name, uint64_t nodes, int threads);
+  void Report(const Result& result);
+
+  std::string Dir(uint64_t i) const;
+  std::string Path(uint64_t i) const;
+
+  void CreateDirs(DataTree* tree, uint64_t nodes);
+
+  void Checkpoint(DataTree* tree, uint64_t nodes);
+  void Execute(uint64_t nodes);
+
+  const DBBenchOptions& options_;
+  ServerOptions server_options_;
+  Transaction txn_;
+  std::string value_;
+  std::vector<std::unique_ptr<Result>> results_;
+
+  // No copying allowed
+  DBBench(const DBBench&);
+  void operator=(const DBBench&);
+};
+
+DBBench::DBBench(const DBBenchOptions& options)
+    : options_(options), value_(static_cast<size_t>(options.value_size), 'v') {
+  server_options_.paxos_group_size = 1;
+  // Never make the checkpoints while executing.
+  server_options_.make_checkpoint_interval = UINT32_MAX;
+  server_options_.checkpoint_storage_path = "/tmp/db_bench";
+  txn_.set_group_id(0);
+  txn_.set_instance_id(0);
+  txn_.set_time(NowMillis());
+}
+
+Result* DBBench::NewResult(const std::string& name, uint64_t nodes,
+                           int threads) {
+  results_.push_back(
+      std::unique_ptr<Result>(new Result(name, nodes, threads)));
+  return results_.back().get();
+}
+
+void DBBench::Report(const Result& result) {
+  fprintf(stderr, "%s\n", result.ToJson().c_str());
+}
+
+std::string DBBench::ToJson() const {
+  std::string s = "{\"config\":" + options_.ToJson() + ",\"results\":[";
+  for (size_t i = 0; i < results_.size(); ++i) {
+    if (i != 0) {
+      s.push_back(',');
+    }
+    s.append(results_[i]->ToJson());
+  }
+  s.append("]}\n");
+  return s;
+}
+
+std::string DBBench::Dir(uint64_t i) const {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s/d%llu", kRoot,
+           static_cast<unsigned long long>(i / options_.fanout));
+  return buf;
+}
+
+std::string DBBench::Path(uint64_t i) const {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s/d%llu/k%llu", kRoot,
+           static_cast<unsigned long long>(i / options_.fanout),
+           static_cast<unsigned long long>(i));
+  return buf;
+}
+
+void DBBench::RunParallel(Result* result, int threads, uint64_t ops,
+                          const OpFunc& op) {
+  CountDownLatch start(1);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([this, t, threads, ops, &op, &start,
+                                   result]() {
+      std::mt19937_64 rng(options_.seed + static_cast<uint64_t>(t));
+      start.Wait();
+      for (uint64_t i = static_cast<uint64_t>(t); i < ops;
+           i += static_cast<uint64_t>(threads)) {
+        op(t, i, &rng, result);
+      }
+    }));
+  }
+  uint64_t begin = NowNanos();
+  start.CountDown();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  result->seconds = static_cast<double>(NowNanos() - begin) / 1e9;
+  Report(*result);
+}
+
+void DBBench::CreateDirs(DataTree* tree, uint64_t nodes) {
+  CreateRequest request;
+  CreateResponse response;
+  request.set_path(kRoot);
+  tree->Create(request, &txn_, &response);
+  uint64_t fanout = static_cast<uint64_t>(options_.fanout);
+  for (uint64_t i = 0; i < nodes; i += fanout) {
+    request.set_path(Dir(i));
+    tree->Create(request, &txn_, &response);
+  }
+}
+
+void DBBench::Run(uint64_t nodes, int threads, bool first) {
+  std::unique_ptr<DataTree> tree(new DataTree(server_options_));
+  CreateDirs(tree.get(), nodes);
+  uint64_t ops = static_cast<uint64_t>(options_.ops);
+  uint64_t dirs = (nodes + options_.fanout - 1) / options_.fanout;
+
+  // The tree is always filled, but only reported if it is benchmarked.
+  Result* result = NewResult("create", nodes, threads);
+  RunParallel(result, threads, nodes,
+              [this, &tree](int, uint64_t i, std::mt19937_64*, Result* r) {
+                CreateRequest request;
+                CreateResponse response;
+                request.set_path(Path(i));
+                request.set_data(value_);
+                uint64_t start = NowNanos();
+                tree->Create(request, &txn_, &response);
+                r->latency.Record(NowNanos() - start);
+              });
+  if (!options_.Has("create")) {
+    results_.pop_back();
+  }
+
+  if (options_.Has("getdata")) {
+    RunParallel(NewResult("getdata", nodes, threads), threads, ops,
+                [this, &tree, nodes](int, uint64_t, std::mt19937_64* rng,
+                                     Result* r) {
+                  GetDataRequest request;
+                  GetDataResponse response;
+                  request.set_path(Path((*rng)() % nodes));
+                  uint64_t start = NowNanos();
+                  tree->GetData(request, nullptr, &response);
+                  r->latency.Record(NowNanos() - start);
+                });
+  }
+
+  // One watcher for each thread, like the sessions of the IO threads.
+  std::vector<std::unique_ptr<CountingWatcher>> watchers;
+  for (int t = 0; t < threads; ++t) {
+    watchers.push_back(
+        std::unique_ptr<CountingWatcher>(new CountingWatcher()));
+  }
+
+  if (options_.Has("getdata_watch")) {
+    RunParallel(NewResult("getdata_watch", nodes, threads), threads, ops,
+                [this, &tree, &watchers, nodes](int t, uint64_t,
+                                                std::mt19937_64* rng,
+                                                Result* r) {
+                  GetDataRequest request;
+                  GetDataResponse response;
+                  request.set_path(Path((*rng)() % nodes));
+                  request.set_watch(true);
+                  uint64_t start = NowNanos();
+                  tree->GetData(request, watchers[t].get(), &response);
+                  r->latency.Record(NowNanos() - start);
+                });
+    for (auto& watcher : watchers) {
+      tree->RemoveWatcher(watcher.get());
+    }
+  }
+
+  if (options_.Has("setdata")) {
+    RunParallel(NewResult("setdata", nodes, threads), threads, ops,
+                [this, &tree, nodes](int, uint64_t, std::mt19937_64* rng,
+                                     Result* r) {
+                  SetDataRequest request;
+                  SetDataResponse response;
+                  request.set_path(Path((*rng)() % nodes));
+                  request.set_data(value_);
+                  request.set_version(-1);
+                  uint64_t start = NowNanos();
+                  tree->SetData(request, &txn_, &response);
+                  r->latency.Record(NowNanos() - start);
+                });
+  }
+
+  // Each op watches the node first, so that the set fires the watch.
+  if (options_.Has("setdata_watch")) {
+    RunParallel(NewResult("setdata_watch", nodes, threads), threads, ops,
+                [this, &tree, &watchers, nodes](int t, uint64_t,
+                                                std::mt19937_64* rng,
+                                                Result* r) {
+                  GetDataRequest get;
+                  GetDataResponse get_response;
+                  get.set_path(Path((*rng)() % nodes));
+                  get.set_watch(true);
+                  tree->GetData(get, watchers[t].get(), &get_response);
+                  SetDataRequest request;
+                  SetDataResponse response;
+                  request.set_path(get.path());
+                  request.set_data(value_);
+                  request.set_version(-1);
+                  uint64_t start = NowNanos();
+                  tree->SetData(request, &txn_, &response);
+                  r->latency.Record(NowNanos() - start);
+                });
+    for (auto& watcher : watchers) {
+      tree->RemoveWatcher(watcher.get());
+    }
+  }
+
+  if (options_.Has("getchildren")) {
+    RunParallel(NewResult("getchildren", nodes, threads), threads, ops,
+                [this, &tree, dirs](int, uint64_t, std::mt19937_64* rng,
+                                    Result* r) {
+                  GetChildrenRequest request;
+                  GetChildrenResponse response;
+                  request.set_path(
+                      Dir(((*rng)() % dirs) * options_.fanout));
+                  uint64_t start = NowNanos();
+                  tree->GetChildren(request, nullptr, &response);
+                  r->latency.Record(NowNanos() - start);
+                });
+  }
+
+  // The sessions own a tenth of the nodes as their ephemeral nodes, and
+  // each op kills one session.
+  if (options_.Has("killsession")) {
+    uint64_t ephemerals = static_cast<uint64_t>(options_.ephemerals);
+    uint64_t sessions = nodes / 10 / ephemerals;
+    sessions = sessions > 0 ? sessions : 1;
+    CreateRequest request;
+    CreateResponse response;
+    request.set_type(NT_EPHEMERAL);
+    request.set_data(value_);
+    Transaction txn(txn_);
+    for (uint64_t s = 0; s < sessions; ++s) {
+      txn.set_session_id(s + 1);
+      for (uint64_t j = 0; j < ephemerals; ++j) {
+        uint64_t i = (s * ephemerals + j) % nodes;
+        request.set_path(Path(i) + "-e" + std::to_string(s));
+        tree->Create(request, &txn, &response);
+      }
+    }
+    RunParallel(NewResult("killsession", nodes, threads), threads, sessions,
+                [this, &tree](int, uint64_t i, std::mt19937_64*, Result* r) {
+                  std::vector<uint64_t> session_ids(1, i + 1);
+                  uint64_t start = NowNanos();
+                  tree->KillSessions(session_ids, &txn_);
+                  r->latency.Record(NowNanos() - start);
+                });
+  }
+
+  // The checkpoints and SaberDB are only used by one thread in the server.
+  if (first && options_.Has("checkpoint")) {
+    Checkpoint(tree.get(), nodes);
+  }
+  if (first && options_.Has("execute")) {
+    Execute(nodes);
+  }
+
+  if (options_.Has("delete")) {
+    RunParallel(NewResult("delete", nodes, threads), threads, nodes,
+                [this, &tree](int, uint64_t i, std::mt19937_64*, Result* r) {
+                  DeleteRequest request;
+                  DeleteResponse response;
+                  request.set_path(Path(i));
+                  request.set_version(-1);
+                  uint64_t start = NowNanos();
+                  tree->Delete(request, &txn_, &response);
+                  r->latency.Record(NowNanos() - start);
+                });
+  }
+}
+
+// Serialize the tree as SaberDB does in both ways, and recover a new tree
+// from the result.
+void DBBench::Checkpoint(DataTree* tree, uint64_t nodes) {
+  std::string s;
+  s.reserve(1024 * tree->NodeSize());
+  Result* result = NewResult("checkpoint_serialize", nodes, 1);
+  uint64_t start = NowNanos();
+  tree->SerializeToString(&s);
+  uint64_t nanos = NowNanos() - start;
+  result->latency.Record(nanos);
+  result->seconds = static_cast<double>(nanos) / 1e9;
+  result->bytes = s.size();
+  Report(*result);
+
+  result = NewResult("checkpoint_copy_serialize", nodes, 1);
+  start = NowNanos();
+  std::unique_ptr<std::unordered_map<std::string, DataNode>> copy_nodes(
+      tree->CopyNodes());
+  std::unique_ptr<std::unordered_map<std::string, std::set<std::string>>>
+      copy_childrens(tree->CopyChildrens());
+  std::string copy;
+  copy.reserve(1024 * copy_nodes->size());
+  DataTree::SerializeToString(*copy_nodes, *copy_childrens, &copy);
+  nanos = NowNanos() - start;
+  result->latency.Record(nanos);
+  result->seconds = static_cast<double>(nanos) / 1e9;
+  result->bytes = copy.size();
+  Report(*result);
+
+  result = NewResult("checkpoint_recover", nodes, 1);
+  std::unique_ptr<DataTree> recovered(new DataTree(server_options_));
+  start = NowNanos();
+  recovered->Recover(s, 0);
+  nanos = NowNanos() - start;
+  result->latency.Record(nanos);
+  result->seconds = static_cast<double>(nanos) / 1e9;
+  result->bytes = s.size();
+  Report(*result);
+  if (recovered->NodeSize() != tree->NodeSize()) {
+    fprintf(stderr, "Recovered %zu nodes but %zu were serialized.\n",
+            recovered->NodeSize(), tree->NodeSize());
+    exit(1);
+  }
+}
+
+// Apply the creates and then the sets through SaberDB::Execute with the
+// replies, as the paxos thread does. The values are serialized before
+// they are timed.
+void DBBench::Execute(uint64_t nodes) {
+  RunLoopThread thread;
+  SaberDB db(thread.Loop(), server_options_);
+  uint64_t instance_id = 0;
+  SaberMessage message;
+  SaberMessage reply;
+  std::string value;
+  std::string txn = txn_.SerializeAsString();
+
+  auto apply = [&](MessageType type, const std::string& data, Result* r) {
+    message.set_type(type);
+    message.set_data(data);
+    message.set_extra_data(txn);
+    message.SerializeToString(&value);
+    reply.Clear();
+    reply.set_type(type);
+    uint64_t start = NowNanos();
+    db.Execute(0, instance_id++, value, &reply);
+    if (r) {
+      r->latency.Record(NowNanos() - start);
+    }
+  };
+
+  CreateRequest create;
+  create.set_path(kRoot);
+  apply(MT_CREATE, create.SerializeAsString(), nullptr);
+  uint64_t fanout = static_cast<uint64_t>(options_.fanout);
+  for (uint64_t i = 0; i < nodes; i += fanout) {
+    create.set_path(Dir(i));
+    apply(MT_CREATE, create.SerializeAsString(), nullptr);
+  }
+
+  Result* result = NewResult("execute_create", nodes, 1);
+  create.set_data(value_);
+  uint64_t start = NowNanos();
+  for (uint64_t i = 0; i < nodes; ++i) {
+    create.set_path(Path(i));
+    apply(MT_CREATE, create.SerializeAsString(), result);
+  }
+  result->seconds = static_cast<double>(NowNanos() - start) / 1e9;
+  Report(*result);
+
+  result = NewResult("execute_setdata", nodes, 1);
+  std::mt19937_64 rng(options_.seed);
+  SetDataRequest set;
+  set.set_data(value_);
+  set.set_version(-1);
+  start = NowNanos();
+  for (int i = 0; i < options_.ops; ++i) {
+    set.set_path(Path(rng() % nodes));
+    apply(MT_SETDATA, set.SerializeAsString(), result);
+  }
+  result->seconds = static_cast<double>(NowNanos() - start) / 1e9;
+  Report(*result);
+}
+
+}  // namespace saber
+
+int main(int argc, char** argv) {
+  saber::DBBenchOptions options;
+  if (!options.Parse(argc, argv)) {
+    options.Print(stderr);
+    return -1;
+  }
+
+  saber::DBBench bench(options);
+  for (uint64_t nodes : options.node_counts) {
+    for (size_t i = 0; i < options.thread_counts.size(); ++i) {
+      bench.Run(nodes, options.thread_counts[i], i == 0);
+    }
+  }
+
+  FILE* f =
+      options.output.empty() ? stdout : fopen(options.output.c_str(), "w");
+  if (f == nullptr) {
+    fprintf(stderr, "Open %s failed.\n", options.output.c_str());
+    return -1;
+  }
+  fputs(bench.ToJson().c_str(), f);
+  if (f != stdout) {
+    fclose(f);
+  }
+  return 0;
+}
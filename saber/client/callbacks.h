@@ -20,6 +20,10 @@ typedef std::function<void(const std::string& path, void* context,
                            const DeleteResponse&)>
     DeleteCallback;
 
+typedef std::function<void(const std::string& path, void* context,
+                           const DeleteRecursiveResponse&)>
+    DeleteRecursiveCallback;
+
 typedef std::function<void(const std::string& path, void* context,
                            const ExistsResponse&)>
     ExistsCallback;
@@ -32,6 +36,10 @@ typedef std::function<void(const std::string& path, void* context,
                            const SetDataResponse&)>
     SetDataCallback;
 
+typedef std::function<void(const std::string& path, void* context,
+                           const IncrementResponse&)>
+    IncrementCallback;
+
 typedef std::function<void(const std::string& path, void* context,
                            const GetACLResponse&)>
     GetACLCallback;
@@ -44,6 +52,15 @@ typedef std::function<void(const std::string& path, void* context,
                            const GetChildrenResponse&)>
     GetChildrenCallback;
 
+typedef std::function<void(const std::string& path, void* context,
+                           const GetChildrenDeltaResponse&)>
+    GetChildrenDeltaCallback;
+
+// The timeline of a traced request, which is called when its reply is
+// received.
+typedef std::function<void(MessageType type, const Trace& trace)>
+    TraceCallback;
+
 }  // namespace saber
 
 #endif  // SABER_CLIENT_CALLBACKS_H_
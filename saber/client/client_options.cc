@@ -6,6 +6,10 @@
 
 namespace saber {
 
-ClientOptions::ClientOptions() : watcher(nullptr), server_manager(nullptr) {}
+ClientOptions::ClientOptions()
+    : watcher(nullptr),
+      server_manager(nullptr),
+      trace_sample_interval(0),
+      trace_cb(nullptr) {}
 
 }  // namespace saber
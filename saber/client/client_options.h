@@ -5,8 +5,11 @@
 #ifndef SABER_CLIENT_CLIENT_OPTIONS_H_
 #define SABER_CLIENT_CLIENT_OPTIONS_H_
 
+#include <stdint.h>
+
 #include <string>
 
+#include "saber/client/callbacks.h"
 #include "saber/client/server_manager.h"
 #include "saber/service/watcher.h"
 
@@ -24,6 +27,17 @@ struct ClientOptions {
   // Default: nullptr
   ServerManager* server_manager;
 
+  // Trace one of every trace_sample_interval requests, zero means no
+  // request is traced.
+  // Default: 0
+  uint32_t trace_sample_interval;
+
+  // It is called in the loop of the client with the timeline of each traced
+  // request, whose send and receive times are stamped by the client and the
+  // others by the server.
+  // Default: nullptr
+  TraceCallback trace_cb;
+
   ClientOptions();
 };
 
@@ -53,7 +53,8 @@ void ClientWatchManager::AddChildWatch(const std::string& path,
 WatcherSetPtr ClientWatchManager::Trigger(const WatchedEvent& event) {
   WatcherSetPtr result;
   switch (event.type()) {
-    case ET_NONE: {
+    case ET_NONE:
+    case ET_RESYNC: {
       result.reset(new WatcherSet());
       if (watcher_) {
         result->insert(watcher_);
@@ -45,6 +45,11 @@ bool Saber::Delete(const DeleteRequest& request, void* context,
   return client_->Delete(request, context, cb);
 }
 
+bool Saber::DeleteRecursive(const DeleteRecursiveRequest& request,
+                            void* context, const DeleteRecursiveCallback& cb) {
+  return client_->DeleteRecursive(request, context, cb);
+}
+
 bool Saber::Exists(const ExistsRequest& request, Watcher* watcher,
                    void* context, const ExistsCallback& cb) {
   return client_->Exists(request, watcher, context, cb);
@@ -60,6 +65,11 @@ bool Saber::SetData(const SetDataRequest& request, void* context,
   return client_->SetData(request, context, cb);
 }
 
+bool Saber::Increment(const IncrementRequest& request, void* context,
+                      const IncrementCallback& cb) {
+  return client_->Increment(request, context, cb);
+}
+
 bool Saber::GetACL(const GetACLRequest& request, void* context,
                    const GetACLCallback& cb) {
   return client_->GetACL(request, context, cb);
@@ -75,4 +85,10 @@ bool Saber::GetChildren(const GetChildrenRequest& request, Watcher* watcher,
   return client_->GetChildren(request, watcher, context, cb);
 }
 
+bool Saber::GetChildrenDelta(const GetChildrenDeltaRequest& request,
+                             Watcher* watcher, void* context,
+                             const GetChildrenDeltaCallback& cb) {
+  return client_->GetChildrenDelta(request, watcher, context, cb);
+}
+
 }  // namespace saber
@@ -31,6 +31,9 @@ class Saber {
   bool Delete(const DeleteRequest& request, void* context,
               const DeleteCallback& cb);
 
+  bool DeleteRecursive(const DeleteRecursiveRequest& request, void* context,
+                       const DeleteRecursiveCallback& cb);
+
   bool Exists(const ExistsRequest& request, Watcher* watcher, void* context,
               const ExistsCallback& cb);
 
@@ -40,6 +43,9 @@ class Saber {
   bool SetData(const SetDataRequest& request, void* context,
                const SetDataCallback& cb);
 
+  bool Increment(const IncrementRequest& request, void* context,
+                 const IncrementCallback& cb);
+
   bool GetACL(const GetACLRequest& request, void* context,
               const GetACLCallback& cb);
 
@@ -49,6 +55,10 @@ class Saber {
   bool GetChildren(const GetChildrenRequest& request, Watcher* watcher,
                    void* context, const GetChildrenCallback& cb);
 
+  bool GetChildrenDelta(const GetChildrenDeltaRequest& request,
+                        Watcher* watcher, void* context,
+                        const GetChildrenDeltaCallback& cb);
+
  private:
   std::atomic<bool> connect_;
   std::shared_ptr<SaberClient> client_;
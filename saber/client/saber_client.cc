@@ -4,6 +4,7 @@
 
 #include "saber/client/saber_client.h"
 
+#include <random>
 #include <utility>
 
 #include "saber/util/logging.h"
@@ -37,6 +38,10 @@ SaberClient::SaberClient(voyager::EventLoop* loop, const ClientOptions& options)
       can_send_(false),
       message_id_(0),
       session_id_(0),
+      kTraceSampleInterval(options.trace_sample_interval),
+      trace_cb_(options.trace_cb),
+      trace_count_(0),
+      trace_id_(0),
       loop_(loop),
       server_manager_(options.server_manager),
       server_manager_impl_(nullptr),
@@ -52,6 +57,10 @@ SaberClient::SaberClient(voyager::EventLoop* loop, const ClientOptions& options)
     server_manager_ = server_manager_impl_;
   }
   server_manager_->UpdateServers(options.servers);
+  if (kTraceSampleInterval != 0) {
+    std::random_device rd;
+    trace_id_ = static_cast<uint64_t>(rd()) << 32 | rd();
+  }
 }
 
 SaberClient::~SaberClient() {
@@ -136,6 +145,29 @@ bool SaberClient::Delete(const DeleteRequest& request, void* context,
   return true;
 }
 
+bool SaberClient::DeleteRecursive(const DeleteRecursiveRequest& request,
+                                  void* context,
+                                  const DeleteRecursiveCallback& cb) {
+  if (GetRoot(request.path()) != kRoot) {
+    return false;
+  }
+  SaberMessage* message = new SaberMessage();
+  message->set_type(MT_DELETERECURSIVE);
+  message->set_data(request.SerializeAsString());
+
+  DeleteRecursiveRequestT* r =
+      new DeleteRecursiveRequestT(request.path(), nullptr, context, cb);
+
+  loop_->RunInLoop([this, message, r]() {
+    r->message_id = ++message_id_;
+    message->set_id(message_id_);
+    delete_recursive_queue_.push_back(
+        std::unique_ptr<DeleteRecursiveRequestT>(r));
+    TrySendInLoop(message);
+  });
+  return true;
+}
+
 bool SaberClient::Exists(const ExistsRequest& request, Watcher* watcher,
                          void* context, const ExistsCallback& cb) {
   if (GetRoot(request.path()) != kRoot) {
@@ -198,6 +230,27 @@ bool SaberClient::SetData(const SetDataRequest& request, void* context,
   return true;
 }
 
+bool SaberClient::Increment(const IncrementRequest& request, void* context,
+                            const IncrementCallback& cb) {
+  if (GetRoot(request.path()) != kRoot) {
+    return false;
+  }
+  SaberMessage* message = new SaberMessage();
+  message->set_type(MT_INCREMENT);
+  message->set_data(request.SerializeAsString());
+
+  IncrementRequestT* r =
+      new IncrementRequestT(request.path(), nullptr, context, cb);
+
+  loop_->RunInLoop([this, message, r]() {
+    r->message_id = ++message_id_;
+    message->set_id(message_id_);
+    increment_queue_.push_back(std::unique_ptr<IncrementRequestT>(r));
+    TrySendInLoop(message);
+  });
+  return true;
+}
+
 bool SaberClient::GetACL(const GetACLRequest& request, void* context,
                          const GetACLCallback& cb) {
   if (GetRoot(request.path()) != kRoot) {
@@ -260,6 +313,29 @@ bool SaberClient::GetChildren(const GetChildrenRequest& request,
   return true;
 }
 
+bool SaberClient::GetChildrenDelta(const GetChildrenDeltaRequest& request,
+                                   Watcher* watcher, void* context,
+                                   const GetChildrenDeltaCallback& cb) {
+  if (GetRoot(request.path()) != kRoot) {
+    return false;
+  }
+  SaberMessage* message = new SaberMessage();
+  message->set_type(MT_GETCHILDRENDELTA);
+  message->set_data(request.SerializeAsString());
+
+  GetChildrenDeltaRequestT* r =
+      new GetChildrenDeltaRequestT(request.path(), watcher, context, cb);
+
+  loop_->RunInLoop([this, message, r]() {
+    r->message_id = ++message_id_;
+    message->set_id(message_id_);
+    children_delta_queue_.push_back(
+        std::unique_ptr<GetChildrenDeltaRequestT>(r));
+    TrySendInLoop(message);
+  });
+  return true;
+}
+
 void SaberClient::Connect(const voyager::SockAddr& addr) {
   if (!has_started_) {
     return;
@@ -278,12 +354,22 @@ void SaberClient::Connect(const voyager::SockAddr& addr) {
 }
 
 void SaberClient::TrySendInLoop(SaberMessage* message) {
+  MaybeTrace(message);
   outgoing_queue_.push_back(std::unique_ptr<SaberMessage>(message));
   if (can_send_) {
     codec_.SendMessage(client_->GetTcpConnectionPtr(), *message);
   }
 }
 
+void SaberClient::MaybeTrace(SaberMessage* message) {
+  if (kTraceSampleInterval == 0 || ++trace_count_ % kTraceSampleInterval != 0) {
+    return;
+  }
+  Trace* trace = message->mutable_trace();
+  trace->set_id(++trace_id_);
+  trace->set_client_send_micros(NowMicros());
+}
+
 void SaberClient::OnConnection(const voyager::TcpConnectionPtr& p) {
   LOG_DEBUG("SaberClient::OnConnection - connect successfully!");
   ConnectRequest request;
@@ -338,12 +424,19 @@ bool SaberClient::OnMessage(const voyager::TcpConnectionPtr& p,
       done = false;
       OnNotification(message.get());
       break;
+    case MT_NOTIFICATIONS:
+      done = false;
+      OnNotifications(message.get());
+      break;
     case MT_CREATE:
       result = OnCreate(message.get());
       break;
     case MT_DELETE:
       result = OnDelete(message.get());
       break;
+    case MT_DELETERECURSIVE:
+      result = OnDeleteRecursive(message.get());
+      break;
     case MT_EXISTS:
       result = OnExists(message.get());
       break;
@@ -353,6 +446,9 @@ bool SaberClient::OnMessage(const voyager::TcpConnectionPtr& p,
     case MT_SETDATA:
       result = OnSetData(message.get());
       break;
+    case MT_INCREMENT:
+      result = OnIncrement(message.get());
+      break;
     case MT_GETACL:
       result = OnGetACL(message.get());
       break;
@@ -362,6 +458,9 @@ bool SaberClient::OnMessage(const voyager::TcpConnectionPtr& p,
     case MT_GETCHILDREN:
       result = OnGetChildren(message.get());
       break;
+    case MT_GETCHILDRENDELTA:
+      result = OnGetChildrenDelta(message.get());
+      break;
     case MT_MASTER: {
       done = false;
       master_.ParseFromString(message->data());
@@ -402,6 +501,10 @@ bool SaberClient::OnMessage(const voyager::TcpConnectionPtr& p,
           outgoing_queue_.front()->id());
     }
   }
+  if (done && message->has_trace() && trace_cb_) {
+    message->mutable_trace()->set_client_receive_micros(NowMicros());
+    trace_cb_(type, message->trace());
+  }
   if (done) {
     assert(!outgoing_queue_.empty());
     assert(outgoing_queue_.front()->id() == message->id());
@@ -432,6 +535,14 @@ void SaberClient::OnNotification(SaberMessage* message) {
   TriggerWatchers(event);
 }
 
+void SaberClient::OnNotifications(SaberMessage* message) {
+  WatchedEvents events;
+  events.ParseFromString(message->data());
+  for (int i = 0; i < events.events_size(); ++i) {
+    TriggerWatchers(events.events(i));
+  }
+}
+
 void SaberClient::OnConnect(SaberMessage* message) {
   ConnectResponse response;
   response.ParseFromString(message->data());
@@ -518,6 +629,31 @@ bool SaberClient::OnDelete(SaberMessage* message) {
   return true;
 }
 
+bool SaberClient::OnDeleteRecursive(SaberMessage* message) {
+  if (delete_recursive_queue_.empty()) {
+    return false;
+  }
+  DeleteRecursiveResponse response;
+  response.set_code(RC_UNKNOWN);
+  auto request = std::move(delete_recursive_queue_.front());
+  delete_recursive_queue_.pop_front();
+  assert(message->id() == request->message_id);
+  while (message->id() > request->message_id) {
+    request->callback(request->path, request->context, response);
+    if (delete_recursive_queue_.empty()) {
+      return false;
+    }
+    request = std::move(delete_recursive_queue_.front());
+    delete_recursive_queue_.pop_front();
+  }
+  if (message->id() != request->message_id) {
+    return false;
+  }
+  response.ParseFromString(message->data());
+  request->callback(request->path, request->context, response);
+  return true;
+}
+
 bool SaberClient::OnExists(SaberMessage* message) {
   if (exists_queue_.empty()) {
     return false;
@@ -571,7 +707,8 @@ bool SaberClient::OnGetData(SaberMessage* message) {
     return false;
   }
   response.ParseFromString(message->data());
-  if (request->watcher && response.code() == RC_OK) {
+  if (request->watcher &&
+      (response.code() == RC_OK || response.code() == RC_NOT_MODIFIED)) {
     watch_manager_.AddDataWatch(request->path, request->watcher);
   }
   request->callback(request->path, request->context, response);
@@ -603,6 +740,31 @@ bool SaberClient::OnSetData(SaberMessage* message) {
   return true;
 }
 
+bool SaberClient::OnIncrement(SaberMessage* message) {
+  if (increment_queue_.empty()) {
+    return false;
+  }
+  IncrementResponse response;
+  response.set_code(RC_UNKNOWN);
+  auto request = std::move(increment_queue_.front());
+  increment_queue_.pop_front();
+  assert(message->id() == request->message_id);
+  while (message->id() > request->message_id) {
+    request->callback(request->path, request->context, response);
+    if (increment_queue_.empty()) {
+      return false;
+    }
+    request = std::move(increment_queue_.front());
+    increment_queue_.pop_front();
+  }
+  if (message->id() != request->message_id) {
+    return false;
+  }
+  response.ParseFromString(message->data());
+  request->callback(request->path, request->context, response);
+  return true;
+}
+
 bool SaberClient::OnGetACL(SaberMessage* message) {
   if (get_acl_queue_.empty()) {
     return false;
@@ -674,6 +836,35 @@ bool SaberClient::OnGetChildren(SaberMessage* message) {
     return false;
   }
   response.ParseFromString(message->data());
+  if (request->watcher &&
+      (response.code() == RC_OK || response.code() == RC_NOT_MODIFIED)) {
+    watch_manager_.AddChildWatch(request->path, request->watcher);
+  }
+  request->callback(request->path, request->context, response);
+  return true;
+}
+
+bool SaberClient::OnGetChildrenDelta(SaberMessage* message) {
+  if (children_delta_queue_.empty()) {
+    return false;
+  }
+  GetChildrenDeltaResponse response;
+  response.set_code(RC_UNKNOWN);
+  auto request = std::move(children_delta_queue_.front());
+  children_delta_queue_.pop_front();
+  assert(message->id() == request->message_id);
+  while (message->id() > request->message_id) {
+    request->callback(request->path, request->context, response);
+    if (children_delta_queue_.empty()) {
+      return false;
+    }
+    request = std::move(children_delta_queue_.front());
+    children_delta_queue_.pop_front();
+  }
+  if (message->id() != request->message_id) {
+    return false;
+  }
+  response.ParseFromString(message->data());
   if (request->watcher && response.code() == RC_OK) {
     watch_manager_.AddChildWatch(request->path, request->watcher);
   }
@@ -700,12 +891,15 @@ void SaberClient::TriggerWatchers(const WatchedEvent& event) {
 void SaberClient::ClearMessage() {
   create_queue_.clear();
   delete_queue_.clear();
+  delete_recursive_queue_.clear();
   exists_queue_.clear();
   get_data_queue_.clear();
   set_data_queue_.clear();
+  increment_queue_.clear();
   get_acl_queue_.clear();
   set_acl_queue_.clear();
   children_queue_.clear();
+  children_delta_queue_.clear();
   outgoing_queue_.clear();
 }
 
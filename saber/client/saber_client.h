@@ -38,6 +38,9 @@ class SaberClient : public std::enable_shared_from_this<SaberClient> {
   bool Delete(const DeleteRequest& request, void* context,
               const DeleteCallback& cb);
 
+  bool DeleteRecursive(const DeleteRecursiveRequest& request, void* context,
+                       const DeleteRecursiveCallback& cb);
+
   bool Exists(const ExistsRequest& request, Watcher* watcher, void* context,
               const ExistsCallback& cb);
 
@@ -47,6 +50,9 @@ class SaberClient : public std::enable_shared_from_this<SaberClient> {
   bool SetData(const SetDataRequest& request, void* context,
                const SetDataCallback& cb);
 
+  bool Increment(const IncrementRequest& request, void* context,
+                 const IncrementCallback& cb);
+
   bool GetACL(const GetACLRequest& request, void* context,
               const GetACLCallback& cb);
 
@@ -56,12 +62,17 @@ class SaberClient : public std::enable_shared_from_this<SaberClient> {
   bool GetChildren(const GetChildrenRequest& request, Watcher* watcher,
                    void* context, const GetChildrenCallback& cb);
 
+  bool GetChildrenDelta(const GetChildrenDeltaRequest& request,
+                        Watcher* watcher, void* context,
+                        const GetChildrenDeltaCallback& cb);
+
  private:
   static void WeakCallback(std::weak_ptr<SaberClient> client_wp,
                            const voyager::TcpConnectionPtr& p);
   void CloseInLoop();
   void Connect(const voyager::SockAddr& addr);
   void TrySendInLoop(SaberMessage* message);
+  void MaybeTrace(SaberMessage* message);
   void OnConnection(const voyager::TcpConnectionPtr& p);
   void OnFailue();
   void OnClose(const voyager::TcpConnectionPtr& p);
@@ -71,15 +82,19 @@ class SaberClient : public std::enable_shared_from_this<SaberClient> {
                voyager::ProtoCodecError code);
   void OnTimer();
   void OnNotification(SaberMessage* message);
+  void OnNotifications(SaberMessage* message);
   void OnConnect(SaberMessage* message);
   bool OnCreate(SaberMessage* message);
   bool OnDelete(SaberMessage* message);
+  bool OnDeleteRecursive(SaberMessage* message);
   bool OnExists(SaberMessage* message);
   bool OnGetData(SaberMessage* message);
   bool OnSetData(SaberMessage* message);
+  bool OnIncrement(SaberMessage* message);
   bool OnGetACL(SaberMessage* message);
   bool OnSetACL(SaberMessage* message);
   bool OnGetChildren(SaberMessage* message);
+  bool OnGetChildrenDelta(SaberMessage* message);
   void TriggerState();
   void TriggerWatchers(const WatchedEvent& event);
   void ClearMessage();
@@ -92,6 +107,12 @@ class SaberClient : public std::enable_shared_from_this<SaberClient> {
   uint32_t message_id_;
   uint64_t session_id_;
 
+  const uint32_t kTraceSampleInterval;
+  TraceCallback trace_cb_;
+  uint64_t trace_count_;
+  // Starts at a random number so that the ids of the clients differ.
+  uint64_t trace_id_;
+
   voyager::EventLoop* loop_;
   ServerManager* server_manager_;
   ServerManagerImpl* server_manager_impl_;
@@ -102,12 +123,15 @@ class SaberClient : public std::enable_shared_from_this<SaberClient> {
 
   std::deque<std::unique_ptr<CreateRequestT> > create_queue_;
   std::deque<std::unique_ptr<DeleteRequestT> > delete_queue_;
+  std::deque<std::unique_ptr<DeleteRecursiveRequestT> > delete_recursive_queue_;
   std::deque<std::unique_ptr<ExistsRequestT> > exists_queue_;
   std::deque<std::unique_ptr<GetDataRequestT> > get_data_queue_;
   std::deque<std::unique_ptr<SetDataRequestT> > set_data_queue_;
+  std::deque<std::unique_ptr<IncrementRequestT> > increment_queue_;
   std::deque<std::unique_ptr<GetACLRequestT> > get_acl_queue_;
   std::deque<std::unique_ptr<SetACLRequestT> > set_acl_queue_;
   std::deque<std::unique_ptr<GetChildrenRequestT> > children_queue_;
+  std::deque<std::unique_ptr<GetChildrenDeltaRequestT> > children_delta_queue_;
 
   std::deque<std::unique_ptr<SaberMessage> > outgoing_queue_;
 
@@ -26,12 +26,15 @@ class SaberRequest {
 
 typedef SaberRequest<CreateCallback> CreateRequestT;
 typedef SaberRequest<DeleteCallback> DeleteRequestT;
+typedef SaberRequest<DeleteRecursiveCallback> DeleteRecursiveRequestT;
 typedef SaberRequest<ExistsCallback> ExistsRequestT;
 typedef SaberRequest<GetDataCallback> GetDataRequestT;
 typedef SaberRequest<SetDataCallback> SetDataRequestT;
+typedef SaberRequest<IncrementCallback> IncrementRequestT;
 typedef SaberRequest<GetACLCallback> GetACLRequestT;
 typedef SaberRequest<SetACLCallback> SetACLRequestT;
 typedef SaberRequest<GetChildrenCallback> GetChildrenRequestT;
+typedef SaberRequest<GetChildrenDeltaCallback> GetChildrenDeltaRequestT;
 
 }  // namespace saber
 
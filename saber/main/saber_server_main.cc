@@ -6,6 +6,7 @@
 #include <unistd.h>
 
 #include <saber/server/saber_server.h>
+#include <saber/util/async_logging.h>
 #include <saber/util/logging.h>
 #include <skywalker/logging.h>
 #include <voyager/core/eventloop.h>
@@ -64,13 +65,19 @@ int main(int argc, char** argv) {
     server_options.all_server_messages.push_back(server_message);
   }
 
-  voyager::EventLoop loop;
-  saber::SaberServer saber_server(&loop, server_options);
-
   voyager::SetLogLevel(voyager::LOGLEVEL_ERROR);
   skywalker::SetLogLevel(skywalker::LOGLEVEL_WARN);
   saber::SetLogLevel(saber::LOGLEVEL_INFO);
 
+  // Keep the logs of the IO and paxos threads off the disk. It is declared
+  // before the server, so that it is stopped after the server is destroyed.
+  saber::AsyncLoggingOptions logging_options;
+  saber::AsyncLogging logging(logging_options);
+  logging.Start();
+
+  voyager::EventLoop loop;
+  saber::SaberServer saber_server(&loop, server_options);
+
   bool res = saber_server.Start();
   if (res) {
     printf("--------------------------------------------------------------\n");
@@ -51,6 +51,9 @@ std::string ToString(EventType type) {
     case ET_NODE_CHILDREN_CHANGED:
       s = "Node Children Changed";
       break;
+    case ET_RESYNC:
+      s = "Resync";
+      break;
     default:
       s = "Unknown";
       assert(false);
@@ -101,6 +104,15 @@ std::string ToString(ResponseCode code) {
     case RC_UNKNOWN:
       s = "UnKnown";
       break;
+    case RC_NOT_MODIFIED:
+      s = "NotModified";
+      break;
+    case RC_BAD_ARGUMENTS:
+      s = "BadArguments";
+      break;
+    case RC_QUOTA_EXCEEDED:
+      s = "QuotaExceeded";
+      break;
     default:
       s = "Unknown";
       assert(false);
@@ -148,6 +160,12 @@ std::string ToString(const Stat& stat) {
   s += "ephemeral_id: ";
   s += std::to_string(stat.ephemeral_id());
   s += "\n";
+  s += "ttl: ";
+  s += std::to_string(stat.ttl());
+  s += "\n";
+  s += "container: ";
+  s += stat.container() ? "true" : "false";
+  s += "\n";
   return s;
 }
 
@@ -166,6 +184,16 @@ std::string ToString(const DeleteResponse& response) {
   return s;
 }
 
+std::string ToString(const DeleteRecursiveResponse& response) {
+  std::string s = ToString(response.code());
+  if (response.code() == RC_OK) {
+    s += "count: ";
+    s += std::to_string(response.count());
+    s += "\n";
+  }
+  return s;
+}
+
 std::string ToString(const ExistsResponse& response) {
   std::string s = ToString(response.code());
   if (response.code() == RC_OK) {
@@ -198,6 +226,19 @@ std::string ToString(const SetDataResponse& response) {
   return s;
 }
 
+std::string ToString(const IncrementResponse& response) {
+  std::string s = ToString(response.code());
+  if (response.code() != RC_OK && response.code() != RC_BAD_VERSION) {
+    return s;
+  }
+  s += "value: ";
+  s += std::to_string(response.value());
+  s += "\n";
+  s += "stat:\n";
+  s += ToString(response.stat());
+  return s;
+}
+
 std::string ToString(const GetACLResponse& response) {
   std::string s = ToString(response.code());
   if (response.code() != RC_OK) {
@@ -245,6 +286,43 @@ std::string ToString(const GetChildrenResponse& response) {
     s += response.children(i);
     s += "\n";
   }
+  if (response.has_more()) {
+    s += "has_more: true\n";
+  }
+  return s;
+}
+
+std::string ToString(const GetChildrenDeltaResponse& response) {
+  std::string s = ToString(response.code());
+  if (response.code() != RC_OK) {
+    return s;
+  }
+  s += "stat:\n";
+  s += ToString(response.stat());
+  if (response.full()) {
+    s += "children:\n";
+    for (int i = 0; i < response.children_size(); ++i) {
+      s += std::to_string(i + 1);
+      s += ": ";
+      s += response.children(i);
+      s += "\n";
+    }
+  } else {
+    s += "added:\n";
+    for (int i = 0; i < response.added_size(); ++i) {
+      s += std::to_string(i + 1);
+      s += ": ";
+      s += response.added(i);
+      s += "\n";
+    }
+    s += "removed:\n";
+    for (int i = 0; i < response.removed_size(); ++i) {
+      s += std::to_string(i + 1);
+      s += ": ";
+      s += response.removed(i);
+      s += "\n";
+    }
+  }
   return s;
 }
 
@@ -18,12 +18,15 @@ std::string ToString(ResponseCode code);
 std::string ToString(const Stat& stat);
 std::string ToString(const CreateResponse& response);
 std::string ToString(const DeleteResponse& response);
+std::string ToString(const DeleteRecursiveResponse& response);
 std::string ToString(const ExistsResponse& response);
 std::string ToString(const GetDataResponse& response);
 std::string ToString(const SetDataResponse& response);
+std::string ToString(const IncrementResponse& response);
 std::string ToString(const GetACLResponse& response);
 std::string ToString(const SetACLResponse& response);
 std::string ToString(const GetChildrenResponse& response);
+std::string ToString(const GetChildrenDeltaResponse& response);
 
 }  // namespace saber
 
@@ -0,0 +1,404 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "saber/server/admin_server.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <voyager/core/sockaddr.h>
+
+#include "saber/server/saber_server.h"
+#include "saber/server/slow_op_log.h"
+#include "saber/util/metrics.h"
+#include "saber/util/timeops.h"
+
+namespace saber {
+
+namespace {
+
+// The connection is closed if a command line is longer than it.
+const size_t kMaxLineSize = 1024;
+
+const char kHelp[] =
+    "commands: groups, roots, sessions, metrics, traces, slowops, stat, "
+    "help\n"
+    "add \"json\" after the command to get the reply in JSON\n";
+
+void AppendJsonString(const std::string& value, std::string* s) {
+  s->push_back('"');
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      s->push_back('\\');
+      s->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+      s->append(buf);
+    } else {
+      s->push_back(c);
+    }
+  }
+  s->push_back('"');
+}
+
+// Print UINTMAX_MAX, which means none, as "-" in text or null in JSON.
+std::string InstanceIdToString(uint64_t id, bool json) {
+  if (id == UINTMAX_MAX) {
+    return json ? "null" : "-";
+  }
+  return std::to_string(id);
+}
+
+// Print the time of the stage as the microseconds after the request was
+// received, or "-" if the stage was not passed.
+std::string StageToString(uint64_t micros, const Trace& trace) {
+  if (micros == 0) {
+    return "-";
+  }
+  if (micros < trace.received_micros()) {
+    return "0";
+  }
+  return std::to_string(micros - trace.received_micros());
+}
+
+}  // namespace
+
+AdminServer::AdminServer(SaberServer* server, const std::string& host,
+                         uint16_t port)
+    : server_(server),
+      admin_(thread_.Loop(), voyager::SockAddr(host, port), "AdminServer", 1) {
+}
+
+AdminServer::~AdminServer() {}
+
+void AdminServer::Start() {
+  admin_.SetMessageCallback(
+      [this](const voyager::TcpConnectionPtr& p, voyager::Buffer* buf) {
+        OnMessage(p, buf);
+      });
+  admin_.Start();
+}
+
+void AdminServer::OnMessage(const voyager::TcpConnectionPtr& p,
+                            voyager::Buffer* buf) {
+  while (true) {
+    const char* data = buf->Peek();
+    size_t size = buf->ReadableSize();
+    const char* end = static_cast<const char*>(memchr(data, '\n', size));
+    if (end == nullptr) {
+      if (size > kMaxLineSize) {
+        p->ShutDown();
+      }
+      break;
+    }
+    std::string line(data, end);
+    buf->Retrieve(static_cast<size_t>(end - data) + 1);
+    p->SendMessage(Execute(line));
+  }
+}
+
+std::string AdminServer::Execute(const std::string& line) {
+  std::vector<std::string> words;
+  size_t i = 0;
+  while (i < line.size()) {
+    size_t j = line.find_first_of(" \t\r", i);
+    if (j == std::string::npos) {
+      j = line.size();
+    }
+    if (j > i) {
+      words.push_back(line.substr(i, j - i));
+    }
+    i = j + 1;
+  }
+  if (words.empty()) {
+    return std::string();
+  }
+
+  const std::string& command = words[0];
+  bool json = words.size() == 2 && words[1] == "json";
+  bool all = command == "stat";
+  if (words.size() > 2 || (words.size() == 2 && !json) ||
+      (!all && command != "groups" && command != "roots" &&
+       command != "sessions" &&
+       command != "metrics" && command != "traces" &&
+       command != "slowops")) {
+    if (command == "help") {
+      return kHelp;
+    }
+    return "unknown command: " + line + "\n" + kHelp;
+  }
+
+  std::string s;
+  if (json) {
+    s.push_back('{');
+  }
+  if (all || command == "groups") {
+    AppendGroups(json, &s);
+  }
+  if (all || command == "roots") {
+    if (json && s.size() > 1) {
+      s.push_back(',');
+    }
+    AppendRoots(json, &s);
+  }
+  if (all || command == "sessions") {
+    if (json && s.size() > 1) {
+      s.push_back(',');
+    }
+    AppendSessions(json, &s);
+  }
+  if (all || command == "metrics") {
+    if (json && s.size() > 1) {
+      s.push_back(',');
+    }
+    AppendMetrics(json, &s);
+  }
+  if (all || command == "traces") {
+    if (json && s.size() > 1) {
+      s.push_back(',');
+    }
+    AppendTraces(json, &s);
+  }
+  if (all || command == "slowops") {
+    if (json && s.size() > 1) {
+      s.push_back(',');
+    }
+    AppendSlowOps(json, &s);
+  }
+  if (json) {
+    s.append("}\n");
+  }
+  return s;
+}
+
+void AdminServer::AppendGroups(bool json, std::string* s) {
+  std::vector<SaberServer::GroupStats> groups;
+  server_->GetGroupStats(&groups);
+  uint64_t now = NowMicros();
+  if (json) {
+    s->append("\"groups\":[");
+  }
+  char buf[256];
+  for (auto& g : groups) {
+    std::string age;
+    if (g.checkpoint_time == 0) {
+      age = json ? "null" : "-";
+    } else {
+      uint64_t micros = now > g.checkpoint_time ? now - g.checkpoint_time : 0;
+      age = std::to_string(micros / 1000000);
+    }
+    std::string applied = InstanceIdToString(g.applied_instance_id, json);
+    std::string checkpoint = InstanceIdToString(g.checkpoint_instance_id, json);
+    if (json) {
+      if (g.group_id != 0) {
+        s->push_back(',');
+      }
+      snprintf(buf, sizeof(buf), "{\"group\":%u,\"master\":%s,\"master_addr\":",
+               g.group_id, g.master ? "true" : "false");
+      s->append(buf);
+      AppendJsonString(g.master_addr, s);
+      snprintf(buf, sizeof(buf),
+               ",\"applied\":%s,\"nodes\":%llu,\"bytes\":%llu,\"watches\":%zu,"
+               "\"sessions\":%zu,\"checkpoint\":%s,\"checkpoint_age\":%s}",
+               applied.c_str(), static_cast<unsigned long long>(g.nodes),
+               static_cast<unsigned long long>(g.bytes), g.watches,
+               g.sessions, checkpoint.c_str(), age.c_str());
+      s->append(buf);
+    } else {
+      snprintf(buf, sizeof(buf),
+               "group %u: master=%s master_addr=%s applied=%s nodes=%llu "
+               "bytes=%llu watches=%zu sessions=%zu checkpoint=%s "
+               "checkpoint_age=%ss\n",
+               g.group_id, g.master ? "yes" : "no",
+               g.master_addr.empty() ? "-" : g.master_addr.c_str(),
+               applied.c_str(), static_cast<unsigned long long>(g.nodes),
+               static_cast<unsigned long long>(g.bytes), g.watches,
+               g.sessions, checkpoint.c_str(), age.c_str());
+      s->append(buf);
+    }
+  }
+  if (json) {
+    s->push_back(']');
+  }
+}
+
+void AdminServer::AppendRoots(bool json, std::string* s) {
+  std::vector<SaberServer::RootStats> roots;
+  server_->GetRootStats(&roots);
+  if (json) {
+    s->append("\"roots\":[");
+  }
+  char buf[128];
+  for (size_t i = 0; i < roots.size(); ++i) {
+    const SaberServer::RootStats& root = roots[i];
+    if (json) {
+      snprintf(buf, sizeof(buf), "%s{\"group\":%u,\"root\":",
+               i == 0 ? "" : ",", root.group_id);
+      s->append(buf);
+      AppendJsonString(root.root, s);
+      snprintf(buf, sizeof(buf), ",\"nodes\":%llu,\"bytes\":%llu}",
+               static_cast<unsigned long long>(root.nodes),
+               static_cast<unsigned long long>(root.bytes));
+      s->append(buf);
+    } else {
+      s->append("root ");
+      s->append(root.root);
+      snprintf(buf, sizeof(buf), ": group=%u nodes=%llu bytes=%llu\n",
+               root.group_id, static_cast<unsigned long long>(root.nodes),
+               static_cast<unsigned long long>(root.bytes));
+      s->append(buf);
+    }
+  }
+  if (json) {
+    s->push_back(']');
+  }
+}
+
+void AdminServer::AppendSessions(bool json, std::string* s) {
+  std::vector<SaberServer::SessionStats> sessions;
+  server_->GetSessionStats(&sessions);
+  if (json) {
+    s->append("\"sessions\":[");
+  }
+  char buf[256];
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    const SaberServer::SessionStats& session = sessions[i];
+    if (json) {
+      snprintf(buf, sizeof(buf),
+               "%s{\"session\":%llu,\"group\":%u,\"pending\":%zu,"
+               "\"buffered_bytes\":%zu}",
+               i == 0 ? "" : ",",
+               static_cast<unsigned long long>(session.session_id),
+               session.group_id, session.pending_messages,
+               session.buffered_bytes);
+    } else {
+      snprintf(buf, sizeof(buf),
+               "session %llu: group=%u pending=%zu buffered_bytes=%zu\n",
+               static_cast<unsigned long long>(session.session_id),
+               session.group_id, session.pending_messages,
+               session.buffered_bytes);
+    }
+    s->append(buf);
+  }
+  if (json) {
+    s->push_back(']');
+  }
+}
+
+void AdminServer::AppendMetrics(bool json, std::string* s) {
+  MetricsSnapshot snapshot;
+  server_->GetMetrics(&snapshot);
+  if (json) {
+    s->append("\"metrics\":");
+    s->append(snapshot.ToJson());
+  } else {
+    s->append(snapshot.ToString());
+  }
+}
+
+void AdminServer::AppendTraces(bool json, std::string* s) {
+  std::vector<TraceRecorder::TraceRecord> traces;
+  server_->GetSlowTraces(&traces);
+  if (json) {
+    s->append("\"traces\":[");
+  }
+  char buf[512];
+  for (size_t i = 0; i < traces.size(); ++i) {
+    const TraceRecorder::TraceRecord& record = traces[i];
+    const Trace& t = record.trace;
+    if (json) {
+      snprintf(buf, sizeof(buf),
+               "%s{\"id\":%llu,\"group\":%u,\"session\":%llu,\"type\":\"%s\","
+               "\"client_send\":%llu,\"received\":%llu,\"started\":%llu,"
+               "\"checked\":%llu,\"proposed\":%llu,\"applied\":%llu,"
+               "\"committed\":%llu,\"sent\":%llu}",
+               i == 0 ? "" : ",", static_cast<unsigned long long>(t.id()),
+               record.group_id,
+               static_cast<unsigned long long>(record.session_id),
+               MessageType_Name(record.type).c_str(),
+               static_cast<unsigned long long>(t.client_send_micros()),
+               static_cast<unsigned long long>(t.received_micros()),
+               static_cast<unsigned long long>(t.started_micros()),
+               static_cast<unsigned long long>(t.checked_micros()),
+               static_cast<unsigned long long>(t.proposed_micros()),
+               static_cast<unsigned long long>(t.applied_micros()),
+               static_cast<unsigned long long>(t.committed_micros()),
+               static_cast<unsigned long long>(t.sent_micros()));
+    } else {
+      std::string started = StageToString(t.started_micros(), t);
+      std::string checked = StageToString(t.checked_micros(), t);
+      std::string proposed = StageToString(t.proposed_micros(), t);
+      std::string applied = StageToString(t.applied_micros(), t);
+      std::string committed = StageToString(t.committed_micros(), t);
+      std::string sent = StageToString(t.sent_micros(), t);
+      snprintf(buf, sizeof(buf),
+               "trace %llu: group=%u session=%llu type=%s received=%llu "
+               "started=%s checked=%s proposed=%s applied=%s committed=%s "
+               "sent=%s\n",
+               static_cast<unsigned long long>(t.id()), record.group_id,
+               static_cast<unsigned long long>(record.session_id),
+               MessageType_Name(record.type).c_str(),
+               static_cast<unsigned long long>(t.received_micros()),
+               started.c_str(), checked.c_str(), proposed.c_str(),
+               applied.c_str(), committed.c_str(), sent.c_str());
+    }
+    s->append(buf);
+  }
+  if (json) {
+    s->push_back(']');
+  }
+}
+
+void AdminServer::AppendSlowOps(bool json, std::string* s) {
+  std::vector<SlowOp> ops;
+  server_->GetSlowOps(&ops);
+  if (json) {
+    s->append("\"slowops\":[");
+  }
+  char buf[512];
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const SlowOp& op = ops[i];
+    snprintf(buf, sizeof(buf),
+             json ? "%s{\"type\":\"%s\",\"message_type\":\"%s\",\"group\":%u,"
+                    "\"session\":%llu,\"instance\":%llu,\"time\":%llu,"
+                    "\"total\":%llu,\"queue\":%llu,\"doit\":%llu,"
+                    "\"commit\":%llu,\"send\":%llu,\"lock_wait\":%llu,"
+                    "\"request_bytes\":%llu,\"reply_bytes\":%llu,"
+                    "\"sessions\":%llu,\"path\":"
+                  : "%sslowop %s %s: group=%u session=%llu instance=%llu "
+                    "time=%llu total=%llu queue=%llu doit=%llu commit=%llu "
+                    "send=%llu lock_wait=%llu request_bytes=%llu "
+                    "reply_bytes=%llu sessions=%llu path=",
+             json && i != 0 ? "," : "", op.TypeName(),
+             MessageType_Name(op.message_type).c_str(), op.group_id,
+             static_cast<unsigned long long>(op.session_id),
+             static_cast<unsigned long long>(op.instance_id),
+             static_cast<unsigned long long>(op.time),
+             static_cast<unsigned long long>(op.total_micros),
+             static_cast<unsigned long long>(op.queue_micros),
+             static_cast<unsigned long long>(op.doit_micros),
+             static_cast<unsigned long long>(op.commit_micros),
+             static_cast<unsigned long long>(op.send_micros),
+             static_cast<unsigned long long>(op.lock_wait_micros),
+             static_cast<unsigned long long>(op.request_bytes),
+             static_cast<unsigned long long>(op.reply_bytes),
+             static_cast<unsigned long long>(op.sessions));
+    s->append(buf);
+    if (json) {
+      AppendJsonString(op.path, s);
+      s->push_back('}');
+    } else {
+      s->append(op.path[0] != '\0' ? op.path : "-");
+      s->push_back('\n');
+    }
+  }
+  if (json) {
+    s->push_back(']');
+  }
+}
+
+}  // namespace saber
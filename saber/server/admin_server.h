@@ -0,0 +1,71 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_SERVER_ADMIN_SERVER_H_
+#define SABER_SERVER_ADMIN_SERVER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include <voyager/core/bg_eventloop.h>
+#include <voyager/core/buffer.h>
+#include <voyager/core/tcp_connection.h>
+#include <voyager/core/tcp_server.h>
+
+namespace saber {
+
+class SaberServer;
+
+// The admin server answers the stats commands of the operators, such as
+//   echo "groups" | nc 127.0.0.1 7666
+// Each command is a line of "<command> [json]", the reply is plain text,
+// or one line of JSON if the command ends with "json". The commands are:
+//   groups    : the master, the last applied instance, the nodes, the
+//               bytes, the watches, the sessions and the checkpoint of
+//               each group.
+//   roots     : the nodes and the bytes of each root, which are limited by
+//               max_root_nodes and max_root_bytes.
+//   sessions  : the pending messages and the bytes of the output buffer
+//               of each session.
+//   metrics   : all the metrics of the server.
+//   traces    : the latest slow traces, the times of the stages are the
+//               microseconds after the request was received.
+//   slowops   : the latest slow requests and SaberDB calls.
+//   stat      : all of the above.
+//   help      : the list of the commands.
+// It runs on its own loop, so that it still answers when the IO threads
+// of the server are busy.
+class AdminServer {
+ public:
+  AdminServer(SaberServer* server, const std::string& host, uint16_t port);
+  ~AdminServer();
+
+  void Start();
+
+  // Execute the command line and return the reply.
+  std::string Execute(const std::string& line);
+
+ private:
+  void OnMessage(const voyager::TcpConnectionPtr& p, voyager::Buffer* buf);
+
+  void AppendGroups(bool json, std::string* s);
+  void AppendRoots(bool json, std::string* s);
+  void AppendSessions(bool json, std::string* s);
+  void AppendMetrics(bool json, std::string* s);
+  void AppendTraces(bool json, std::string* s);
+  void AppendSlowOps(bool json, std::string* s);
+
+  SaberServer* server_;
+  voyager::BGEventLoop thread_;
+  voyager::TcpServer admin_;
+
+  // No copying allowed
+  AdminServer(const AdminServer&);
+  void operator=(const AdminServer&);
+};
+
+}  // namespace saber
+
+#endif  // SABER_SERVER_ADMIN_SERVER_H_
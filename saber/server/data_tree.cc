@@ -4,6 +4,11 @@
 
 #include "saber/server/data_tree.h"
 
+#include <errno.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
 #include <utility>
 #include <vector>
 
@@ -17,7 +22,52 @@ static inline void AppendToString(std::string* s, size_t value) {
   PutFixed32(s, static_cast<uint32_t>(value));
 }
 
-DataTree::DataTree() { nodes_.insert(std::make_pair("", DataNode())); }
+// Only an optional '-' followed by digits without leading zeros is a
+// counter, and "-0" is not, so that the data is always the same after it
+// is rewritten by Increment.
+static bool ParseInt64(const std::string& s, int64_t* value) {
+  if (s.empty()) {
+    *value = 0;
+    return true;
+  }
+  size_t i = s[0] == '-' ? 1 : 0;
+  if (i == s.size() || (s[i] == '0' && (i == 1 || s.size() > 1))) {
+    return false;
+  }
+  for (; i < s.size(); ++i) {
+    if (s[i] < '0' || s[i] > '9') {
+      return false;
+    }
+  }
+  char* end = nullptr;
+  errno = 0;
+  long long v = strtoll(s.c_str(), &end, 10);
+  if (errno != 0 || end != s.c_str() + s.size()) {
+    return false;
+  }
+  *value = static_cast<int64_t>(v);
+  return true;
+}
+
+static const size_t kTimingWheelSize = 1024;
+
+// The number of the watch shards for each server thread.
+static const uint32_t kWatchShardsPerThread = 4;
+
+static std::string GetRoot(const std::string& path) {
+  return path.substr(0, path.find('/', 1));
+}
+
+DataTree::DataTree(const ServerOptions& options)
+    : kMaxDataSize(options.max_data_size),
+      kMaxRootNodes(options.max_root_nodes),
+      kMaxRootBytes(options.max_root_bytes),
+      kCleanupRetry(5 * (options.cleanup_interval / 1000)),
+      ttls_(options.cleanup_interval / 1000, kTimingWheelSize),
+      data_watches_(options.server_thread_size * kWatchShardsPerThread),
+      child_watches_(options.server_thread_size * kWatchShardsPerThread) {
+  nodes_.insert(std::make_pair("", DataNode()));
+}
 
 DataTree::~DataTree() {}
 
@@ -45,7 +95,7 @@ uint64_t DataTree::Recover(const std::string& s, size_t index) {
     p += 4;
 
     if (len > 0) {
-      std::unordered_set<std::string>& children = childrens_[name];
+      std::set<std::string>& children = childrens_[name];
       for (uint32_t idx = 0; idx < len; ++idx) {
         uint32_t temp = DecodeFixed32(p);
         p += 4;
@@ -57,6 +107,14 @@ uint64_t DataTree::Recover(const std::string& s, size_t index) {
     if (node.stat().ephemeral_id() != 0) {
       ephemerals_[node.stat().ephemeral_id()].insert(name);
     }
+    if (node.stat().ttl() != 0) {
+      ttls_.Add(name, node.stat().modified_time() + node.stat().ttl());
+    }
+    if (node.stat().container() && node.stat().children_version() > 0 &&
+        node.stat().children_num() == 0) {
+      containers_.insert(name);
+    }
+    UpdateUsage(name, 1, node.data().size());
   }
 
   return (p - base);
@@ -69,11 +127,20 @@ void DataTree::Create(const CreateRequest& request, const Transaction* txn,
   std::string parent = path.substr(0, found);
   std::string child = path.substr(found + 1);
 
-  if (parent == "" && (request.type() == NT_PERSISTENT_SEQUENTIAL ||
-                       request.type() == NT_EPHEMERAL_SEQUENTIAL)) {
+  bool sequential = request.type() == NT_PERSISTENT_SEQUENTIAL ||
+                    request.type() == NT_EPHEMERAL_SEQUENTIAL ||
+                    request.type() == NT_PERSISTENT_SEQUENTIAL_WITH_TTL;
+  bool ttl = request.type() == NT_PERSISTENT_WITH_TTL ||
+             request.type() == NT_PERSISTENT_SEQUENTIAL_WITH_TTL;
+
+  if (parent == "" && sequential) {
     response->set_code(RC_NO_PARENT);
     return;
   }
+  if (ttl && request.ttl() == 0) {
+    response->set_code(RC_BAD_ARGUMENTS);
+    return;
+  }
 
   {
     MutexLock lock(&mutex_);
@@ -89,8 +156,7 @@ void DataTree::Create(const CreateRequest& request, const Transaction* txn,
       return;
     }
     bool b = false;
-    if (request.type() == NT_PERSISTENT_SEQUENTIAL ||
-        request.type() == NT_EPHEMERAL_SEQUENTIAL) {
+    if (sequential) {
       b = true;
       if (!only_check) {
         char seq[16];
@@ -100,17 +166,27 @@ void DataTree::Create(const CreateRequest& request, const Transaction* txn,
         path.append(seq);
       }
     }
-    std::unordered_set<std::string>& children = childrens_[parent];
-    if (!b && children.find(child) != children.end()) {
+    // Don't insert an empty entry in the check, "has children" must be the
+    // same on every server.
+    auto c = childrens_.find(parent);
+    if (!b && c != childrens_.end() &&
+        c->second.find(child) != c->second.end()) {
       response->set_code(RC_NODE_EXISTS);
+    } else if (only_check && !CheckQuota(path, 1, request.data().size())) {
+      response->set_code(RC_QUOTA_EXCEEDED);
     } else if (only_check) {
       response->set_code(RC_OK);
     } else {
+      std::set<std::string>& children = childrens_[parent];
       children.insert(child);
       Stat* tmp = it->second.mutable_stat();
       tmp->set_children_version(tmp->children_version() + 1);
       tmp->set_children_num(static_cast<uint32_t>(children.size()));
       tmp->set_children_id(txn->instance_id());
+      AddChildrenChange(parent, tmp->children_version(), true, child);
+      if (tmp->container()) {
+        containers_.erase(parent);
+      }
       DataNode& node = nodes_[path];
       Stat* stat = node.mutable_stat();
       stat->set_group_id(txn->group_id());
@@ -126,11 +202,19 @@ void DataTree::Create(const CreateRequest& request, const Transaction* txn,
       stat->set_children_id(txn->instance_id());
       node.set_data(request.data());
       *(node.mutable_acl()) = request.acl();
+      UpdateUsage(path, 1, request.data().size());
       if (request.type() == NT_EPHEMERAL ||
           request.type() == NT_EPHEMERAL_SEQUENTIAL) {
         stat->set_ephemeral_id(txn->session_id());
         ephemerals_[stat->ephemeral_id()].insert(path);
       }
+      if (ttl) {
+        stat->set_ttl(request.ttl());
+        ttls_.Add(path, txn->time() + request.ttl());
+      }
+      if (request.type() == NT_CONTAINER) {
+        stat->set_container(true);
+      }
       response->set_code(RC_OK);
       response->set_path(path);
     }
@@ -173,27 +257,22 @@ void DataTree::Delete(const DeleteRequest& request, const Transaction* txn,
       return;
     }
 
-    if (it->second.stat().ephemeral_id() != 0) {
-      auto e = ephemerals_.find(it->second.stat().ephemeral_id());
-      if (e != ephemerals_.end()) {
-        e->second.erase(path);
-        if (e->second.empty()) {
-          ephemerals_.erase(e);
-        }
-      }
-    }
-    nodes_.erase(it);
+    EraseNode(path, it->second.stat());
     if (p_it != nodes_.end()) {
       if (childrens_.find(parent) != childrens_.end()) {
-        std::unordered_set<std::string>& children = childrens_[parent];
+        std::set<std::string>& children = childrens_[parent];
         if (children.erase(child)) {
           Stat* tmp = p_it->second.mutable_stat();
           tmp->set_children_version(tmp->children_version() + 1);
           tmp->set_children_num(static_cast<uint32_t>(children.size()));
           tmp->set_children_id(txn->instance_id());
+          AddChildrenChange(parent, tmp->children_version(), false, child);
         }
         if (children.empty()) {
           childrens_.erase(parent);
+          if (p_it->second.stat().container()) {
+            containers_.insert(parent);
+          }
         }
       }
       response->set_code(RC_OK);
@@ -208,6 +287,56 @@ void DataTree::Delete(const DeleteRequest& request, const Transaction* txn,
                                 ET_NODE_CHILDREN_CHANGED);
 }
 
+void DataTree::DeleteRecursive(const DeleteRecursiveRequest& request,
+                               const Transaction* txn,
+                               DeleteRecursiveResponse* response,
+                               bool only_check) {
+  const std::string& path = request.path();
+  size_t found = path.find_last_of('/');
+  std::string parent = path.substr(0, found);
+
+  std::vector<std::string> paths;
+  {
+    MutexLock lock(&mutex_);
+    auto it = nodes_.find(path);
+    if (it == nodes_.end()) {
+      response->set_code(RC_NO_NODE);
+      return;
+    }
+    if (request.version() != -1 &&
+        request.version() != it->second.stat().version()) {
+      response->set_code(RC_BAD_VERSION);
+      return;
+    }
+
+    auto p_it = nodes_.find(parent);
+    // TODO
+    if (p_it != nodes_.end() && !CheckACL(p_it->second, kDelete, nullptr)) {
+      response->set_code(RC_NO_AUTH);
+      return;
+    }
+    if (only_check) {
+      response->set_code(RC_OK);
+      return;
+    }
+
+    // Collect the subtree, the parents are always before their children.
+    paths.push_back(path);
+    for (size_t i = 0; i < paths.size(); ++i) {
+      auto c = childrens_.find(paths[i]);
+      if (c != childrens_.end()) {
+        for (auto& child : c->second) {
+          paths.push_back(paths[i] + "/" + child);
+        }
+      }
+    }
+  }
+
+  DeleteNodes(paths, txn);
+  response->set_code(RC_OK);
+  response->set_count(static_cast<uint32_t>(paths.size()));
+}
+
 void DataTree::Exists(const ExistsRequest& request, Watcher* watcher,
                       ExistsResponse* response) {
   const std::string& path = request.path();
@@ -235,8 +364,13 @@ void DataTree::GetData(const GetDataRequest& request, Watcher* watcher,
     if (it != nodes_.end()) {
       // TODO
       if (CheckACL(it->second, kRead, nullptr)) {
-        response->set_code(RC_OK);
-        response->set_data(it->second.data());
+        if (request.has_known_version() &&
+            request.known_version() == it->second.stat().version()) {
+          response->set_code(RC_NOT_MODIFIED);
+        } else {
+          response->set_code(RC_OK);
+          response->set_data(it->second.data());
+        }
         *(response->mutable_stat()) = it->second.stat();
       } else {
         response->set_code(RC_NO_AUTH);
@@ -246,7 +380,7 @@ void DataTree::GetData(const GetDataRequest& request, Watcher* watcher,
     }
   }
 
-  if (response->code() == RC_OK) {
+  if (response->code() == RC_OK || response->code() == RC_NOT_MODIFIED) {
     if (watcher) {
       data_watches_.AddWatcher(path, watcher);
     }
@@ -263,20 +397,109 @@ void DataTree::SetData(const SetDataRequest& request, const Transaction* txn,
     auto it = nodes_.find(path);
     if (it != nodes_.end()) {
       int version = it->second.stat().version();
+      size_t size = it->second.data().size();
+      if (request.type() == SDT_APPEND) {
+        size += data.size();
+      } else if (request.type() == SDT_PATCH) {
+        size = std::max(size, request.offset() + data.size());
+      } else {
+        size = data.size();
+      }
       if (request.version() != -1 && request.version() != version) {
         response->set_code(RC_BAD_VERSION);
       } else if (!CheckACL(it->second, kWrite, nullptr)) {
         response->set_code(RC_NO_AUTH);
+      } else if (request.type() == SDT_PATCH &&
+                 request.offset() > it->second.data().size()) {
+        response->set_code(RC_BAD_ARGUMENTS);
+      } else if (only_check && size > kMaxDataSize) {
+        // Like the quota, the limit is local to each server, so it is only
+        // checked before proposing, the apply must be the same everywhere.
+        response->set_code(RC_BAD_ARGUMENTS);
+      } else if (only_check && size > it->second.data().size() &&
+                 !CheckQuota(path, 0, size - it->second.data().size())) {
+        response->set_code(RC_QUOTA_EXCEEDED);
+      } else if (only_check) {
+        response->set_code(RC_OK);
+      } else {
+        UpdateUsage(path, 0,
+                    static_cast<int64_t>(size) -
+                        static_cast<int64_t>(it->second.data().size()));
+        Stat* stat = it->second.mutable_stat();
+        stat->set_modified_id(txn->instance_id());
+        stat->set_modified_time(txn->time());
+        stat->set_version(version + 1);
+        stat->set_data_len(static_cast<uint32_t>(size));
+        if (request.type() == SDT_APPEND) {
+          it->second.mutable_data()->append(data);
+        } else if (request.type() == SDT_PATCH) {
+          it->second.mutable_data()->replace(request.offset(), data.size(),
+                                             data);
+        } else {
+          it->second.set_data(data);
+        }
+        if (stat->ttl() != 0) {
+          ttls_.Add(path, txn->time() + stat->ttl());
+        }
+        response->set_code(RC_OK);
+        *(response->mutable_stat()) = *stat;
+      }
+    } else {
+      response->set_code(RC_NO_NODE);
+    }
+  }
+
+  if (!only_check && response->code() == RC_OK) {
+    data_watches_.TriggerWatcher(path, ET_NODE_DATA_CHANGED);
+  }
+}
+
+void DataTree::Increment(const IncrementRequest& request,
+                         const Transaction* txn, IncrementResponse* response,
+                         bool only_check) {
+  const std::string& path = request.path();
+  int64_t delta = request.delta();
+
+  {
+    MutexLock lock(&mutex_);
+    auto it = nodes_.find(path);
+    if (it != nodes_.end()) {
+      int version = it->second.stat().version();
+      int64_t value;
+      // Check the ACL first, the value mustn't be returned to the callers
+      // who can't write it.
+      if (!CheckACL(it->second, kWrite, nullptr)) {
+        response->set_code(RC_NO_AUTH);
+      } else if (!ParseInt64(it->second.data(), &value)) {
+        response->set_code(RC_BAD_ARGUMENTS);
+      } else if (request.version() != -1 && request.version() != version) {
+        response->set_code(RC_BAD_VERSION);
+        response->set_value(value);
+        *(response->mutable_stat()) = it->second.stat();
+      } else if ((delta > 0 &&
+                  value > std::numeric_limits<int64_t>::max() - delta) ||
+                 (delta < 0 &&
+                  value < std::numeric_limits<int64_t>::min() - delta)) {
+        response->set_code(RC_BAD_ARGUMENTS);
       } else if (only_check) {
         response->set_code(RC_OK);
       } else {
+        value += delta;
+        std::string data = std::to_string(value);
         Stat* stat = it->second.mutable_stat();
         stat->set_modified_id(txn->instance_id());
         stat->set_modified_time(txn->time());
         stat->set_version(version + 1);
-        stat->set_data_len(static_cast<int>(data.size()));
-        it->second.set_data(data);
+        UpdateUsage(path, 0,
+                    static_cast<int64_t>(data.size()) -
+                        static_cast<int64_t>(it->second.data().size()));
+        stat->set_data_len(static_cast<uint32_t>(data.size()));
+        it->second.set_data(std::move(data));
+        if (stat->ttl() != 0) {
+          ttls_.Add(path, txn->time() + stat->ttl());
+        }
         response->set_code(RC_OK);
+        response->set_value(value);
         *(response->mutable_stat()) = *stat;
       }
     } else {
@@ -337,12 +560,16 @@ void DataTree::GetChildren(const GetChildrenRequest& request, Watcher* watcher,
     if (it != nodes_.end()) {
       // TODO
       if (CheckACL(it->second, kRead, nullptr)) {
-        response->set_code(RC_OK);
         *(response->mutable_stat()) = it->second.stat();
-        if (childrens_.find(path) != childrens_.end()) {
-          const std::unordered_set<std::string>& children = childrens_[path];
-          for (auto& i : children) {
-            response->add_children(i);
+        if (request.has_known_children_version() &&
+            request.known_children_version() ==
+                it->second.stat().children_version()) {
+          response->set_code(RC_NOT_MODIFIED);
+        } else {
+          response->set_code(RC_OK);
+          auto c = childrens_.find(path);
+          if (c != childrens_.end()) {
+            GetChildren(c->second, request, response);
           }
         }
       } else {
@@ -353,6 +580,77 @@ void DataTree::GetChildren(const GetChildrenRequest& request, Watcher* watcher,
     }
   }
 
+  if (response->code() == RC_OK || response->code() == RC_NOT_MODIFIED) {
+    if (watcher) {
+      child_watches_.AddWatcher(path, watcher);
+    }
+  }
+}
+
+void DataTree::GetChildrenDelta(const GetChildrenDeltaRequest& request,
+                                Watcher* watcher,
+                                GetChildrenDeltaResponse* response) {
+  const std::string& path = request.path();
+
+  {
+    MutexLock lock(&mutex_);
+    auto it = nodes_.find(path);
+    if (it != nodes_.end()) {
+      // TODO
+      if (!CheckACL(it->second, kRead, nullptr)) {
+        response->set_code(RC_NO_AUTH);
+      } else if (request.since_created_id() != 0 &&
+                 request.since_created_id() !=
+                     it->second.stat().created_id()) {
+        response->set_code(RC_BAD_VERSION);
+        *(response->mutable_stat()) = it->second.stat();
+      } else {
+        response->set_code(RC_OK);
+        *(response->mutable_stat()) = it->second.stat();
+        int version = it->second.stat().children_version();
+        int since = request.since_children_version();
+        auto c = changes_.find(path);
+        if (since == version) {
+          // Nothing changed.
+        } else if (since < version && c != changes_.end() &&
+                   c->second.front().version <= since + 1) {
+          std::set<std::string> added;
+          std::set<std::string> removed;
+          for (auto& i : c->second) {
+            if (i.version <= since) {
+              continue;
+            }
+            if (i.added) {
+              if (removed.erase(i.child) == 0) {
+                added.insert(i.child);
+              }
+            } else {
+              if (added.erase(i.child) == 0) {
+                removed.insert(i.child);
+              }
+            }
+          }
+          for (auto& i : added) {
+            response->add_added(i);
+          }
+          for (auto& i : removed) {
+            response->add_removed(i);
+          }
+        } else {
+          response->set_full(true);
+          auto children = childrens_.find(path);
+          if (children != childrens_.end()) {
+            for (auto& i : children->second) {
+              response->add_children(i);
+            }
+          }
+        }
+      }
+    } else {
+      response->set_code(RC_NO_NODE);
+    }
+  }
+
   if (response->code() == RC_OK) {
     if (watcher) {
       child_watches_.AddWatcher(path, watcher);
@@ -360,6 +658,165 @@ void DataTree::GetChildren(const GetChildrenRequest& request, Watcher* watcher,
   }
 }
 
+void DataTree::AddChildrenChange(const std::string& parent, int version,
+                                 bool added, const std::string& child) {
+  std::deque<ChildrenChange>& changes = changes_[parent];
+  if (changes.size() >= kMaxChildrenChanges) {
+    // Evict the whole oldest version, so the remaining changes of each
+    // version are always complete.
+    int oldest = changes.front().version;
+    while (!changes.empty() && changes.front().version == oldest) {
+      changes.pop_front();
+    }
+  }
+  changes.push_back(ChildrenChange(version, added, child));
+}
+
+void DataTree::UpdateUsage(const std::string& path, int64_t nodes,
+                           int64_t bytes) {
+  std::string root = GetRoot(path);
+  if (root.empty()) {
+    return;
+  }
+  Usage& usage = usages_[root];
+  usage.nodes += nodes;
+  usage.bytes += bytes;
+  if (usage.nodes == 0) {
+    usages_.erase(root);
+  }
+}
+
+bool DataTree::CheckQuota(const std::string& path, uint64_t nodes,
+                          uint64_t bytes) const {
+  if (kMaxRootNodes == 0 && kMaxRootBytes == 0) {
+    return true;
+  }
+  Usage usage;
+  auto it = usages_.find(GetRoot(path));
+  if (it != usages_.end()) {
+    usage = it->second;
+  }
+  if (kMaxRootNodes != 0 && usage.nodes + nodes > kMaxRootNodes) {
+    return false;
+  }
+  if (kMaxRootBytes != 0 && usage.bytes + bytes > kMaxRootBytes) {
+    return false;
+  }
+  return true;
+}
+
+void DataTree::EraseNode(const std::string& path, const Stat& stat) {
+  if (stat.ephemeral_id() != 0) {
+    auto e = ephemerals_.find(stat.ephemeral_id());
+    if (e != ephemerals_.end()) {
+      e->second.erase(path);
+      if (e->second.empty()) {
+        ephemerals_.erase(e);
+      }
+    }
+  }
+  if (stat.ttl() != 0) {
+    ttls_.Remove(path);
+  }
+  if (stat.container()) {
+    containers_.erase(path);
+  }
+  changes_.erase(path);
+  auto it = nodes_.find(path);
+  UpdateUsage(path, -1, -static_cast<int64_t>(it->second.data().size()));
+  nodes_.erase(it);
+}
+
+void DataTree::DeleteNodes(const std::vector<std::string>& paths,
+                           const Transaction* txn) {
+  std::vector<std::string> deleted;
+  std::unordered_map<std::string, std::vector<std::string>> parents;
+  {
+    MutexLock lock(&mutex_);
+    for (auto& path : paths) {
+      auto it = nodes_.find(path);
+      if (it == nodes_.end()) {
+        LOG_WARN("Ignoring not existed path %s while deleting nodes.",
+                 path.c_str());
+        continue;
+      }
+      EraseNode(path, it->second.stat());
+      size_t found = path.find_last_of('/');
+      parents[path.substr(0, found)].push_back(path.substr(found + 1));
+      deleted.push_back(path);
+    }
+
+    for (auto& p : parents) {
+      const std::string& parent = p.first;
+      auto c = childrens_.find(parent);
+      if (c == childrens_.end()) {
+        continue;
+      }
+      std::vector<std::string> removed;
+      for (auto& child : p.second) {
+        if (c->second.erase(child)) {
+          removed.push_back(child);
+        }
+      }
+      auto p_it = nodes_.find(parent);
+      if (p_it != nodes_.end() && !removed.empty()) {
+        Stat* tmp = p_it->second.mutable_stat();
+        tmp->set_children_version(tmp->children_version() + 1);
+        tmp->set_children_num(static_cast<uint32_t>(c->second.size()));
+        tmp->set_children_id(txn->instance_id());
+        if (removed.size() > kMaxChildrenChanges) {
+          // Too many changes to keep, the delta will be a full listing.
+          changes_.erase(parent);
+        } else {
+          for (auto& child : removed) {
+            AddChildrenChange(parent, tmp->children_version(), false, child);
+          }
+        }
+      }
+      if (c->second.empty()) {
+        childrens_.erase(c);
+        if (p_it != nodes_.end() && p_it->second.stat().container()) {
+          containers_.insert(parent);
+        }
+      }
+    }
+  }
+
+  for (auto& path : deleted) {
+    WatcherSetPtr p = data_watches_.TriggerWatcher(path, ET_NODE_DELETED);
+    child_watches_.TriggerWatcher(path, ET_NODE_DELETED, std::move(p));
+  }
+  for (auto& p : parents) {
+    child_watches_.TriggerWatcher(p.first.empty() ? "/" : p.first,
+                                  ET_NODE_CHILDREN_CHANGED);
+  }
+}
+
+void DataTree::GetChildren(const std::set<std::string>& children,
+                           const GetChildrenRequest& request,
+                           GetChildrenResponse* response) {
+  const std::string& prefix = request.prefix();
+  const std::string& start_after = request.start_after();
+  std::set<std::string>::const_iterator it;
+  if (start_after.empty() || start_after < prefix) {
+    it = children.lower_bound(prefix);
+  } else {
+    it = children.upper_bound(start_after);
+  }
+  uint32_t count = 0;
+  for (; it != children.end(); ++it) {
+    if (it->compare(0, prefix.size(), prefix) != 0) {
+      break;
+    }
+    if (request.limit() != 0 && count == request.limit()) {
+      response->set_has_more(true);
+      break;
+    }
+    response->add_children(*it);
+    ++count;
+  }
+}
+
 // TODO
 bool DataTree::CheckACL(const DataNode& node, Permissions perm,
                         const std::vector<Id>* ids) {
@@ -390,26 +847,95 @@ void DataTree::RemoveWatcher(Watcher* watcher) {
   child_watches_.RemoveWatcher(watcher);
 }
 
-void DataTree::KillSession(uint64_t session_id, const Transaction* txn) {
-  auto it = ephemerals_.find(session_id);
-  if (it != ephemerals_.end()) {
-    std::unordered_set<std::string> paths;
-    paths.swap(it->second);
-    ephemerals_.erase(it);
-    DeleteRequest request;
-    DeleteResponse response;
-    for (auto& p : paths) {
-      request.set_path(p);
-      request.set_version(-1);
-      Delete(request, txn, &response);
-      if (response.code() != RC_OK) {
-        LOG_WARN(
-            "Ignoring not RC_OK for path %s while removing ephemeral "
-            "for dead session %llu.",
-            p.c_str(), (unsigned long long)session_id);
+size_t DataTree::WatchCount() {
+  return data_watches_.WatchCount() + child_watches_.WatchCount();
+}
+
+void DataTree::KillSessions(const std::vector<uint64_t>& session_ids,
+                            const Transaction* txn) {
+  std::vector<std::string> paths;
+  {
+    MutexLock lock(&mutex_);
+    for (auto session_id : session_ids) {
+      auto it = ephemerals_.find(session_id);
+      if (it != ephemerals_.end()) {
+        paths.insert(paths.end(), it->second.begin(), it->second.end());
+        ephemerals_.erase(it);
+      }
+    }
+  }
+  DeleteNodes(paths, txn);
+}
+
+void DataTree::GetExpiredNodes(uint64_t now, std::vector<std::string>* paths) {
+  std::vector<std::string> keys;
+  MutexLock lock(&mutex_);
+  ttls_.Expire(now, &keys);
+  for (auto& key : keys) {
+    auto it = nodes_.find(key);
+    if (it == nodes_.end()) {
+      continue;
+    }
+    if (it->second.stat().children_num() != 0) {
+      // The node with children doesn't expire, check it again later.
+      ttls_.Add(key, now + it->second.stat().ttl());
+    } else {
+      ttls_.Add(key, now + kCleanupRetry);
+      paths->push_back(key);
+    }
+  }
+}
+
+void DataTree::GetEmptyContainers(std::vector<std::string>* paths) {
+  // Keep the containers until they are deleted, in case the cleanup
+  // proposal failed.
+  MutexLock lock(&mutex_);
+  paths->insert(paths->end(), containers_.begin(), containers_.end());
+}
+
+void DataTree::GetUsages(std::map<std::string, Usage>* usages) {
+  MutexLock lock(&mutex_);
+  usages->insert(usages_.begin(), usages_.end());
+}
+
+void DataTree::GetTotalUsage(Usage* usage) {
+  MutexLock lock(&mutex_);
+  usage->nodes = nodes_.size();
+  usage->bytes = 0;
+  // The usages of the roots cover the data of all the nodes but the root
+  // of the tree, whose path is "".
+  for (auto& it : usages_) {
+    usage->bytes += it.second.bytes;
+  }
+  auto it = nodes_.find("");
+  if (it != nodes_.end()) {
+    usage->bytes += it->second.data().size();
+  }
+}
+
+void DataTree::Cleanup(const CleanupRequest& request, const Transaction* txn) {
+  std::vector<std::string> paths;
+  {
+    MutexLock lock(&mutex_);
+    for (int i = 0; i < request.path_size(); ++i) {
+      const std::string& path = request.path(i);
+      auto it = nodes_.find(path);
+      if (it == nodes_.end()) {
+        continue;
+      }
+      const Stat& stat = it->second.stat();
+      if (stat.children_num() != 0) {
+        continue;
+      }
+      if ((stat.ttl() != 0 &&
+           stat.modified_time() + stat.ttl() <= txn->time()) ||
+          (stat.container() && stat.children_version() > 0)) {
+        paths.push_back(path);
       }
     }
   }
+
+  DeleteNodes(paths, txn);
 }
 
 void DataTree::SerializeToString(std::string* s) const {
@@ -420,15 +946,15 @@ std::unordered_map<std::string, DataNode>* DataTree::CopyNodes() const {
   return new std::unordered_map<std::string, DataNode>(nodes_);
 }
 
-std::unordered_map<std::string, std::unordered_set<std::string>>*
+std::unordered_map<std::string, std::set<std::string>>*
 DataTree::CopyChildrens() const {
-  return new std::unordered_map<std::string, std::unordered_set<std::string>>(
+  return new std::unordered_map<std::string, std::set<std::string>>(
       childrens_);
 }
 
 void DataTree::SerializeToString(
     const std::unordered_map<std::string, DataNode>& nodes,
-    const std::unordered_map<std::string, std::unordered_set<std::string>>&
+    const std::unordered_map<std::string, std::set<std::string>>&
         childrens,
     std::string* s) {
   AppendToString(s, nodes.size());
@@ -439,7 +965,7 @@ void DataTree::SerializeToString(
     it.second.AppendToString(s);
     auto iter = childrens.find(it.first);
     if (iter != childrens.end()) {
-      const std::unordered_set<std::string>& children = iter->second;
+      const std::set<std::string>& children = iter->second;
       AppendToString(s, children.size());
       for (auto& child : children) {
         AppendToString(s, child.size());
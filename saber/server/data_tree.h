@@ -5,14 +5,20 @@
 #ifndef SABER_SERVER_DATA_TREE_H_
 #define SABER_SERVER_DATA_TREE_H_
 
+#include <deque>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "saber/proto/saber.pb.h"
 #include "saber/proto/server.pb.h"
+#include "saber/server/server_options.h"
 #include "saber/server/server_watch_manager.h"
+#include "saber/server/timing_wheel.h"
 #include "saber/service/acl.h"
 #include "saber/util/mutex.h"
 
@@ -20,7 +26,14 @@ namespace saber {
 
 class DataTree {
  public:
-  DataTree();
+  // The resource usage of all the nodes under a root.
+  struct Usage {
+    Usage() : nodes(0), bytes(0) {}
+    uint64_t nodes;
+    uint64_t bytes;
+  };
+
+  explicit DataTree(const ServerOptions& options);
   ~DataTree();
 
   uint64_t Recover(const std::string& s, size_t index);
@@ -31,6 +44,11 @@ class DataTree {
   void Delete(const DeleteRequest& request, const Transaction* txn,
               DeleteResponse* response, bool only_check = false);
 
+  void DeleteRecursive(const DeleteRecursiveRequest& request,
+                       const Transaction* txn,
+                       DeleteRecursiveResponse* response,
+                       bool only_check = false);
+
   void Exists(const ExistsRequest& request, Watcher* watcher,
               ExistsResponse* response);
 
@@ -40,6 +58,9 @@ class DataTree {
   void SetData(const SetDataRequest& request, const Transaction* txn,
                SetDataResponse* response, bool only_check = false);
 
+  void Increment(const IncrementRequest& request, const Transaction* txn,
+                 IncrementResponse* response, bool only_check = false);
+
   void GetACL(const GetACLRequest& request, GetACLResponse* response);
 
   void SetACL(const SetACLRequest& request, const Transaction* txn,
@@ -48,9 +69,35 @@ class DataTree {
   void GetChildren(const GetChildrenRequest& request, Watcher* watcher,
                    GetChildrenResponse* response);
 
+  void GetChildrenDelta(const GetChildrenDeltaRequest& request,
+                        Watcher* watcher, GetChildrenDeltaResponse* response);
+
   void RemoveWatcher(Watcher* watcher);
 
-  void KillSession(uint64_t session_id, const Transaction* txn);
+  // The count of the data watches and the child watches, only for stats.
+  size_t WatchCount();
+
+  // Delete the ephemeral nodes of all the sessions in one batch.
+  void KillSessions(const std::vector<uint64_t>& session_ids,
+                    const Transaction* txn);
+
+  // Get the TTL nodes which have expired at now (in milliseconds), they
+  // should be deleted by proposing a CleanupRequest.
+  void GetExpiredNodes(uint64_t now, std::vector<std::string>* paths);
+
+  // Get the container nodes which have no children after their last
+  // child was deleted, they should be deleted by proposing a CleanupRequest.
+  void GetEmptyContainers(std::vector<std::string>* paths);
+
+  // Get the usage of each root which has nodes.
+  void GetUsages(std::map<std::string, Usage>* usages);
+
+  // Get the count of all the nodes and the bytes of their data.
+  void GetTotalUsage(Usage* usage);
+
+  // Delete the nodes of the request which are still expired or empty
+  // containers at the time of the txn.
+  void Cleanup(const CleanupRequest& request, const Transaction* txn);
 
   // No thread safe
   size_t NodeSize() const { return nodes_.size(); }
@@ -67,29 +114,79 @@ class DataTree {
   // Copy all the childrens
   // No thread safe
   // Caller should delete the return value when it's no longer needed.
-  std::unordered_map<std::string, std::unordered_set<std::string>>*
+  std::unordered_map<std::string, std::set<std::string>>*
   CopyChildrens() const;
 
   // Serialize all nodes, and append the result to the *s.
   // Thread safe
   static void SerializeToString(
       const std::unordered_map<std::string, DataNode>& nodes,
-      const std::unordered_map<std::string, std::unordered_set<std::string>>&
+      const std::unordered_map<std::string, std::set<std::string>>&
           childrens,
       std::string* s);
 
  private:
+  struct ChildrenChange {
+    ChildrenChange(int v, bool a, const std::string& c)
+        : version(v), added(a), child(c) {}
+    int version;
+    bool added;
+    std::string child;
+  };
+
+  // Record that the child was added to or removed from the parent, the
+  // version is the parent's children_version after the change. The changes
+  // coalesced into one version share the same version.
+  void AddChildrenChange(const std::string& parent, int version, bool added,
+                         const std::string& child);
+
+  // Add the changes to the usage of the root of the path, mutex_ must be held.
+  void UpdateUsage(const std::string& path, int64_t nodes, int64_t bytes);
+
+  // Check that the root of the path could hold the extra nodes and bytes,
+  // mutex_ must be held.
+  bool CheckQuota(const std::string& path, uint64_t nodes,
+                  uint64_t bytes) const;
+
+  // Erase the node and its bookkeeping, mutex_ must be held.
+  void EraseNode(const std::string& path, const Stat& stat);
+
+  // Delete the nodes under one lock, the children_version of each parent
+  // is bumped only once and one children changed event is fired for it.
+  void DeleteNodes(const std::vector<std::string>& paths,
+                   const Transaction* txn);
+
+  // Append the children which match the request to the response.
+  static void GetChildren(const std::set<std::string>& children,
+                          const GetChildrenRequest& request,
+                          GetChildrenResponse* response);
+
   // TODO
   bool CheckACL(const DataNode& node, Permissions perm,
                 const std::vector<Id>* ids);
 
   static const bool kSkipACL = true;
 
+  const uint32_t kMaxDataSize;
+  const uint64_t kMaxRootNodes;
+  const uint64_t kMaxRootBytes;
+
+  // The time in milliseconds to check the expired node again after it was
+  // returned by GetExpiredNodes, in case the cleanup proposal failed.
+  const uint64_t kCleanupRetry;
+
+  // The max number of the children changes kept for each node.
+  static const size_t kMaxChildrenChanges = 256;
+
   Mutex mutex_;
   std::unordered_map<std::string, DataNode> nodes_;
-  std::unordered_map<std::string, std::unordered_set<std::string>> childrens_;
+  std::unordered_map<std::string, std::set<std::string>> childrens_;
+  std::unordered_map<std::string, std::deque<ChildrenChange>> changes_;
 
   std::unordered_map<uint64_t, std::unordered_set<std::string>> ephemerals_;
+  TimingWheel ttls_;
+  std::unordered_set<std::string> containers_;
+  std::unordered_map<std::string, Usage> usages_;
 
   ServerWatchManager data_watches_;
   ServerWatchManager child_watches_;
@@ -11,6 +11,8 @@
 #include <skywalker/file.h>
 #include <voyager/util/crc32c.h>
 
+#include "saber/server/server_metrics.h"
+#include "saber/server/slow_op_log.h"
 #include "saber/util/coding.h"
 #include "saber/util/logging.h"
 #include "saber/util/timeops.h"
@@ -19,34 +21,81 @@ namespace saber {
 
 namespace {
 static const char* kCheckpoint = "CHECKPOINT-";
+
+// Get the path of the request of the message, only for the slow-op log.
+std::string GetPath(const SaberMessage& message) {
+  switch (message.type()) {
+    case MT_CREATE: {
+      CreateRequest request;
+      request.ParseFromString(message.data());
+      return request.path();
+    }
+    case MT_DELETE: {
+      DeleteRequest request;
+      request.ParseFromString(message.data());
+      return request.path();
+    }
+    case MT_DELETERECURSIVE: {
+      DeleteRecursiveRequest request;
+      request.ParseFromString(message.data());
+      return request.path();
+    }
+    case MT_SETDATA: {
+      SetDataRequest request;
+      request.ParseFromString(message.data());
+      return request.path();
+    }
+    case MT_INCREMENT: {
+      IncrementRequest request;
+      request.ParseFromString(message.data());
+      return request.path();
+    }
+    case MT_SETACL: {
+      SetACLRequest request;
+      request.ParseFromString(message.data());
+      return request.path();
+    }
+    default: {
+      return std::string();
+    }
+  }
+}
 }
 
 inline static uint32_t Value(const char* data, size_t n) {
   return voyager::crc32c::Value(data, n);
 }
 
-SaberDB::SaberDB(RunLoop* loop, const ServerOptions& options)
+SaberDB::SaberDB(RunLoop* loop, const ServerOptions& options,
+                 ServerMetrics* metrics, SlowOpLog* slow_ops)
     : kKeepCheckpointCount(options.keep_checkpoint_count),
       kMakeCheckpointInterval(options.make_checkpoint_interval),
       kAsyncSerializeCheckpointData(options.async_serialize_checkpoint_data),
       lock_(false),
       doing_(false),
       checkpoint_storage_path_(options.checkpoint_storage_path),
-      checkpoint_id_(options.paxos_group_size, UINTMAX_MAX),
+      checkpoint_id_(new std::atomic<uint64_t>[options.paxos_group_size]),
+      checkpoint_time_(new std::atomic<uint64_t>[options.paxos_group_size]),
+      applied_id_(new std::atomic<uint64_t>[options.paxos_group_size]),
       files_(options.paxos_group_size),
       next_interval_(options.paxos_group_size),
       generator_((unsigned)NowMillis()),
       distribution_(1, kMakeCheckpointInterval / 2),
-      loop_(loop) {
+      loop_(loop),
+      metrics_(metrics),
+      slow_ops_(slow_ops) {
   if (checkpoint_storage_path_[checkpoint_storage_path_.size() - 1] != '/') {
     checkpoint_storage_path_.push_back('/');
   }
   trees_.reserve(options.paxos_group_size);
   sessions_.reserve(options.paxos_group_size);
   for (uint32_t i = 0; i < options.paxos_group_size; ++i) {
-    trees_.push_back(std::unique_ptr<DataTree>(new DataTree()));
+    trees_.push_back(std::unique_ptr<DataTree>(new DataTree(options)));
     sessions_.push_back(std::unique_ptr<SessionManager>(new SessionManager()));
     next_interval_[i] = kMakeCheckpointInterval / 2 + distribution_(generator_);
+    checkpoint_id_[i] = UINTMAX_MAX;
+    checkpoint_time_[i] = 0;
+    applied_id_[i] = UINTMAX_MAX;
   }
 }
 
@@ -92,6 +141,7 @@ bool SaberDB::Recover() {
           }
         } else {
           checkpoint_id_[i] = instance_id;
+          applied_id_[i] = instance_id;
           uint64_t index = trees_[i]->Recover(s, 8);
           index = sessions_[i]->Recover(s, index);
           assert(index == s.size());
@@ -138,6 +188,13 @@ void SaberDB::Delete(uint32_t group_id, const DeleteRequest& request,
   trees_[group_id]->Delete(request, txn, response);
 }
 
+void SaberDB::DeleteRecursive(uint32_t group_id,
+                              const DeleteRecursiveRequest& request,
+                              const Transaction* txn,
+                              DeleteRecursiveResponse* response) const {
+  trees_[group_id]->DeleteRecursive(request, txn, response);
+}
+
 void SaberDB::Exists(uint32_t group_id, const ExistsRequest& request,
                      Watcher* watcher, ExistsResponse* response) const {
   trees_[group_id]->Exists(request, watcher, response);
@@ -153,6 +210,12 @@ void SaberDB::SetData(uint32_t group_id, const SetDataRequest& request,
   trees_[group_id]->SetData(request, txn, response);
 }
 
+void SaberDB::Increment(uint32_t group_id, const IncrementRequest& request,
+                        const Transaction* txn,
+                        IncrementResponse* response) const {
+  trees_[group_id]->Increment(request, txn, response);
+}
+
 void SaberDB::GetACL(uint32_t group_id, const GetACLRequest& request,
                      GetACLResponse* response) const {
   trees_[group_id]->GetACL(request, response);
@@ -169,6 +232,13 @@ void SaberDB::GetChildren(uint32_t group_id, const GetChildrenRequest& request,
   trees_[group_id]->GetChildren(request, watcher, response);
 }
 
+void SaberDB::GetChildrenDelta(uint32_t group_id,
+                               const GetChildrenDeltaRequest& request,
+                               Watcher* watcher,
+                               GetChildrenDeltaResponse* response) const {
+  trees_[group_id]->GetChildrenDelta(request, watcher, response);
+}
+
 void SaberDB::CheckCreate(uint32_t group_id, const CreateRequest& request,
                           CreateResponse* response) const {
   trees_[group_id]->Create(request, nullptr, response, true);
@@ -179,11 +249,22 @@ void SaberDB::CheckDelete(uint32_t group_id, const DeleteRequest& request,
   trees_[group_id]->Delete(request, nullptr, response, true);
 }
 
+void SaberDB::CheckDeleteRecursive(uint32_t group_id,
+                                   const DeleteRecursiveRequest& request,
+                                   DeleteRecursiveResponse* response) const {
+  trees_[group_id]->DeleteRecursive(request, nullptr, response, true);
+}
+
 void SaberDB::CheckSetData(uint32_t group_id, const SetDataRequest& request,
                            SetDataResponse* response) const {
   trees_[group_id]->SetData(request, nullptr, response, true);
 }
 
+void SaberDB::CheckIncrement(uint32_t group_id, const IncrementRequest& request,
+                             IncrementResponse* response) const {
+  trees_[group_id]->Increment(request, nullptr, response, true);
+}
+
 void SaberDB::CheckSetACL(uint32_t group_id, const SetACLRequest& request,
                           SetACLResponse* response) const {
   trees_[group_id]->SetACL(request, nullptr, response, true);
@@ -208,6 +289,37 @@ std::unordered_map<uint64_t, uint64_t>* SaberDB::CopySessions(
   return sessions_[group_id]->CopySessions();
 }
 
+void SaberDB::GetExpiredNodes(uint32_t group_id, uint64_t now,
+                              std::vector<std::string>* paths) const {
+  trees_[group_id]->GetExpiredNodes(now, paths);
+}
+
+void SaberDB::GetEmptyContainers(uint32_t group_id,
+                                 std::vector<std::string>* paths) const {
+  trees_[group_id]->GetEmptyContainers(paths);
+}
+
+void SaberDB::GetUsages(uint32_t group_id,
+                        std::map<std::string, DataTree::Usage>* usages) const {
+  trees_[group_id]->GetUsages(usages);
+}
+
+size_t SaberDB::GetWatchCount(uint32_t group_id) const {
+  return trees_[group_id]->WatchCount();
+}
+
+void SaberDB::GetTotalUsage(uint32_t group_id, DataTree::Usage* usage) const {
+  trees_[group_id]->GetTotalUsage(usage);
+}
+
+uint64_t SaberDB::GetAppliedInstanceId(uint32_t group_id) const {
+  return applied_id_[group_id].load(std::memory_order_relaxed);
+}
+
+uint64_t SaberDB::GetCheckpointTime(uint32_t group_id) const {
+  return checkpoint_time_[group_id].load(std::memory_order_relaxed);
+}
+
 bool SaberDB::CreateSession(uint32_t group_id, uint64_t session_id,
                             uint64_t new_version, uint64_t old_version) const {
   return sessions_[group_id]->CreateSession(session_id, new_version,
@@ -219,13 +331,36 @@ bool SaberDB::CloseSession(uint32_t group_id, uint64_t session_id,
   return sessions_[group_id]->CloseSession(session_id, version);
 }
 
-void SaberDB::KillSession(uint32_t group_id, uint64_t session_id,
-                          const Transaction* txn) const {
-  trees_[group_id]->KillSession(session_id, txn);
+void SaberDB::KillSessions(uint32_t group_id,
+                           const std::vector<uint64_t>& session_ids,
+                           const Transaction* txn) const {
+  uint64_t start = NowMonotonicMicros();
+  uint64_t wait_micros = Mutex::WaitMicros();
+  trees_[group_id]->KillSessions(session_ids, txn);
+  uint64_t micros = NowMonotonicMicros() - start;
+  if (slow_ops_ && slow_ops_->IsSlow(SlowOp::kKillSessions, micros)) {
+    SlowOp op;
+    op.type = SlowOp::kKillSessions;
+    op.message_type = MT_CLOSE;
+    op.group_id = group_id;
+    op.instance_id = txn->instance_id();
+    op.time = NowMicros();
+    op.total_micros = micros;
+    op.lock_wait_micros = Mutex::WaitMicros() - wait_micros;
+    op.sessions = session_ids.size();
+    slow_ops_->Add(op);
+  }
+}
+
+void SaberDB::Cleanup(uint32_t group_id, const CleanupRequest& request,
+                      const Transaction* txn) const {
+  trees_[group_id]->Cleanup(request, txn);
 }
 
 bool SaberDB::Execute(uint32_t group_id, uint64_t instance_id,
                       const std::string& value, void* context) {
+  uint64_t start = NowMonotonicMicros();
+  uint64_t wait_micros = Mutex::WaitMicros();
   SaberMessage message;
   message.ParseFromString(value);
   Transaction txn;
@@ -254,11 +389,19 @@ bool SaberDB::Execute(uint32_t group_id, uint64_t instance_id,
     case MT_CLOSE: {
       CloseRequest request;
       request.ParseFromString(message.data());
+      std::vector<uint64_t> session_ids;
       for (int i = 0; i < request.session_id_size(); ++i) {
         if (CloseSession(group_id, request.session_id(i), request.version(i))) {
-          KillSession(group_id, request.session_id(i), &txn);
+          session_ids.push_back(request.session_id(i));
         }
       }
+      KillSessions(group_id, session_ids, &txn);
+      break;
+    }
+    case MT_CLEANUP: {
+      CleanupRequest request;
+      request.ParseFromString(message.data());
+      Cleanup(group_id, request, &txn);
       break;
     }
     case MT_CREATE: {
@@ -281,6 +424,16 @@ bool SaberDB::Execute(uint32_t group_id, uint64_t instance_id,
       }
       break;
     }
+    case MT_DELETERECURSIVE: {
+      DeleteRecursiveRequest request;
+      DeleteRecursiveResponse response;
+      request.ParseFromString(message.data());
+      DeleteRecursive(group_id, request, &txn, &response);
+      if (reply_message) {
+        reply_message->set_data(response.SerializeAsString());
+      }
+      break;
+    }
     case MT_SETDATA: {
       SetDataRequest request;
       SetDataResponse response;
@@ -291,6 +444,16 @@ bool SaberDB::Execute(uint32_t group_id, uint64_t instance_id,
       }
       break;
     }
+    case MT_INCREMENT: {
+      IncrementRequest request;
+      IncrementResponse response;
+      request.ParseFromString(message.data());
+      Increment(group_id, request, &txn, &response);
+      if (reply_message) {
+        reply_message->set_data(response.SerializeAsString());
+      }
+      break;
+    }
     case MT_SETACL: {
       SetACLRequest request;
       SetACLResponse response;
@@ -307,6 +470,29 @@ bool SaberDB::Execute(uint32_t group_id, uint64_t instance_id,
       break;
     }
   }
+  uint64_t micros = NowMonotonicMicros() - start;
+  if (metrics_) {
+    ServerMetrics::Record(metrics_->apply_micros[message.type()], micros);
+  }
+  if (slow_ops_ && slow_ops_->IsSlow(SlowOp::kExecute, micros)) {
+    SlowOp op;
+    op.type = SlowOp::kExecute;
+    op.message_type = message.type();
+    op.group_id = group_id;
+    op.session_id = txn.session_id();
+    op.instance_id = instance_id;
+    op.time = NowMicros();
+    op.total_micros = micros;
+    op.lock_wait_micros = Mutex::WaitMicros() - wait_micros;
+    op.request_bytes = value.size();
+    op.reply_bytes = reply_message ? reply_message->data().size() : 0;
+    op.set_path(GetPath(message));
+    slow_ops_->Add(op);
+  }
+  if (reply_message && reply_message->has_trace()) {
+    reply_message->mutable_trace()->set_applied_micros(NowMicros());
+  }
+  applied_id_[group_id].store(instance_id, std::memory_order_relaxed);
   MaybeMakeCheckpoint(group_id, instance_id);
   return true;
 }
@@ -314,6 +500,7 @@ bool SaberDB::Execute(uint32_t group_id, uint64_t instance_id,
 void SaberDB::MaybeMakeCheckpoint(uint32_t group_id, uint64_t instance_id) {
   bool expected = false;
   if (doing_.compare_exchange_strong(expected, true)) {
+    uint64_t start = NowMonotonicMicros();
     uint64_t i = GetCheckpointInstanceId(group_id);
     if (((i == UINTMAX_MAX && instance_id > next_interval_[group_id]) ||
          (instance_id - i > next_interval_[group_id])) &&
@@ -322,15 +509,17 @@ void SaberDB::MaybeMakeCheckpoint(uint32_t group_id, uint64_t instance_id) {
         auto nodes = trees_[group_id]->CopyNodes();
         auto childrens = trees_[group_id]->CopyChildrens();
         auto sessions = sessions_[group_id]->CopySessions();
-        loop_->QueueInLoop(
-            [this, group_id, instance_id, nodes, childrens, sessions]() {
-              MakeCheckpoint(group_id, instance_id, nodes, childrens, sessions);
-              UnLockCheckpoint(group_id);
-              delete sessions;
-              delete childrens;
-              delete nodes;
-              doing_ = false;
-            });
+        loop_->QueueInLoop([this, group_id, instance_id, nodes, childrens,
+                            sessions, start]() {
+          size_t size = MakeCheckpoint(group_id, instance_id, nodes,
+                                       childrens, sessions);
+          RecordCheckpoint(group_id, instance_id, start, size);
+          UnLockCheckpoint(group_id);
+          delete sessions;
+          delete childrens;
+          delete nodes;
+          doing_ = false;
+        });
       } else {
         size_t size = 1024 * (trees_[group_id]->NodeSize()) +
                       20 * (sessions_[group_id]->SessionSize());
@@ -340,8 +529,9 @@ void SaberDB::MaybeMakeCheckpoint(uint32_t group_id, uint64_t instance_id) {
         trees_[group_id]->SerializeToString(s);
         sessions_[group_id]->SerializeToString(s);
         PutFixed32(s, Value(s->c_str(), s->size()));
-        loop_->QueueInLoop([this, group_id, instance_id, s]() {
+        loop_->QueueInLoop([this, group_id, instance_id, s, start]() {
           MakeCheckpoint(group_id, instance_id, *s);
+          RecordCheckpoint(group_id, instance_id, start, s->size());
           UnLockCheckpoint(group_id);
           delete s;
           doing_ = false;
@@ -353,10 +543,10 @@ void SaberDB::MaybeMakeCheckpoint(uint32_t group_id, uint64_t instance_id) {
   }
 }
 
-void SaberDB::MakeCheckpoint(
+size_t SaberDB::MakeCheckpoint(
     uint32_t group_id, uint64_t instance_id,
     std::unordered_map<std::string, DataNode>* nodes,
-    std::unordered_map<std::string, std::unordered_set<std::string>>* childrens,
+    std::unordered_map<std::string, std::set<std::string>>* childrens,
     std::unordered_map<uint64_t, uint64_t>* sessions) {
   size_t size = 1024 * nodes->size() + 20 * sessions->size();
   std::string s;
@@ -365,16 +555,23 @@ void SaberDB::MakeCheckpoint(
   DataTree::SerializeToString(*nodes, *childrens, &s);
   SessionManager::SerializeToString(*sessions, &s);
   PutFixed32(&s, Value(s.c_str(), s.size()));
-  MakeCheckpoint(group_id, instance_id, s);
+  return MakeCheckpoint(group_id, instance_id, s);
 }
 
-void SaberDB::MakeCheckpoint(uint32_t group_id, uint64_t instance_id,
-                             const std::string& s) {
+size_t SaberDB::MakeCheckpoint(uint32_t group_id, uint64_t instance_id,
+                               const std::string& s) {
   std::string fname = FileName(group_id, instance_id);
   skywalker::Status status = skywalker::WriteStringToFileSync(
       skywalker::FileManager::Instance(), s, fname);
+  if (metrics_) {
+    metrics_->checkpoint_bytes->Record(s.size());
+    if (!status.ok()) {
+      metrics_->checkpoint_failures->Increment();
+    }
+  }
   if (status.ok()) {
     checkpoint_id_[group_id] = instance_id;
+    checkpoint_time_[group_id] = NowMicros();
     files_[group_id].push_back(instance_id);
     LOG_INFO("Group %u: make checkpoint successful, the file is %s.", group_id,
              fname.c_str());
@@ -385,6 +582,25 @@ void SaberDB::MakeCheckpoint(uint32_t group_id, uint64_t instance_id,
   }
   next_interval_[group_id] =
       kMakeCheckpointInterval / 2 + distribution_(generator_);
+  return s.size();
+}
+
+void SaberDB::RecordCheckpoint(uint32_t group_id, uint64_t instance_id,
+                               uint64_t start_micros, size_t size) {
+  uint64_t micros = NowMonotonicMicros() - start_micros;
+  if (metrics_) {
+    metrics_->checkpoint_micros->Record(micros);
+  }
+  if (slow_ops_ && slow_ops_->IsSlow(SlowOp::kCheckpoint, micros)) {
+    SlowOp op;
+    op.type = SlowOp::kCheckpoint;
+    op.group_id = group_id;
+    op.instance_id = instance_id;
+    op.time = NowMicros();
+    op.total_micros = micros;
+    op.reply_bytes = size;
+    slow_ops_->Add(op);
+  }
 }
 
 void SaberDB::CleanCheckpoint(uint32_t group_id) {
@@ -395,7 +611,6 @@ void SaberDB::CleanCheckpoint(uint32_t group_id) {
 }
 
 uint64_t SaberDB::GetCheckpointInstanceId(uint32_t group_id) {
-  // FIXME no thread safe
   return checkpoint_id_[group_id];
 }
 
@@ -446,6 +661,7 @@ bool SaberDB::LoadCheckpoint(uint32_t group_id, uint64_t instance_id,
   }
 
   checkpoint_id_[group_id] = instance_id;
+  checkpoint_time_[group_id] = NowMicros();
   files_[group_id].push_back(instance_id);
 
   LOG_INFO("Group %u: load checkpoint successful! the file is %s.", group_id,
@@ -6,8 +6,10 @@
 #define SABER_SERVER_SABER_DB_H_
 
 #include <atomic>
+#include <map>
 #include <memory>
 #include <random>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -24,9 +26,14 @@
 
 namespace saber {
 
+class SlowOpLog;
+struct ServerMetrics;
+
 class SaberDB : public skywalker::StateMachine, public skywalker::Checkpoint {
  public:
-  SaberDB(RunLoop* loop, const ServerOptions& options);
+  // The metrics and the slow-op log may be nullptr if they are not needed.
+  SaberDB(RunLoop* loop, const ServerOptions& options,
+          ServerMetrics* metrics = nullptr, SlowOpLog* slow_ops = nullptr);
   virtual ~SaberDB();
 
   bool Recover();
@@ -43,15 +50,27 @@ class SaberDB : public skywalker::StateMachine, public skywalker::Checkpoint {
   void GetChildren(uint32_t group_id, const GetChildrenRequest& request,
                    Watcher* watcher, GetChildrenResponse* response) const;
 
+  void GetChildrenDelta(uint32_t group_id,
+                        const GetChildrenDeltaRequest& request,
+                        Watcher* watcher,
+                        GetChildrenDeltaResponse* response) const;
+
   void CheckCreate(uint32_t group_id, const CreateRequest& request,
                    CreateResponse* response) const;
 
   void CheckDelete(uint32_t group_id, const DeleteRequest& request,
                    DeleteResponse* response) const;
 
+  void CheckDeleteRecursive(uint32_t group_id,
+                            const DeleteRecursiveRequest& request,
+                            DeleteRecursiveResponse* response) const;
+
   void CheckSetData(uint32_t group_id, const SetDataRequest& request,
                     SetDataResponse* response) const;
 
+  void CheckIncrement(uint32_t group_id, const IncrementRequest& request,
+                      IncrementResponse* response) const;
+
   void CheckSetACL(uint32_t group_id, const SetACLRequest& request,
                    SetACLResponse* response) const;
 
@@ -65,6 +84,26 @@ class SaberDB : public skywalker::StateMachine, public skywalker::Checkpoint {
 
   std::unordered_map<uint64_t, uint64_t>* CopySessions(uint32_t group_id) const;
 
+  void GetExpiredNodes(uint32_t group_id, uint64_t now,
+                       std::vector<std::string>* paths) const;
+
+  void GetEmptyContainers(uint32_t group_id,
+                          std::vector<std::string>* paths) const;
+
+  void GetUsages(uint32_t group_id,
+                 std::map<std::string, DataTree::Usage>* usages) const;
+
+  size_t GetWatchCount(uint32_t group_id) const;
+
+  // The stats of each group, which can be got in any thread.
+  // Get the count of the nodes and the bytes of their data.
+  void GetTotalUsage(uint32_t group_id, DataTree::Usage* usage) const;
+  // Return UINTMAX_MAX if no instance has been applied.
+  uint64_t GetAppliedInstanceId(uint32_t group_id) const;
+  // Return the time (in microseconds) when the last checkpoint was made or
+  // loaded, or zero if it was recovered at startup or there is none.
+  uint64_t GetCheckpointTime(uint32_t group_id) const;
+
   virtual bool Execute(uint32_t group_id, uint64_t instance_id,
                        const std::string& value, void* context);
 
@@ -92,27 +131,39 @@ class SaberDB : public skywalker::StateMachine, public skywalker::Checkpoint {
   void Delete(uint32_t group_id, const DeleteRequest& request,
               const Transaction* txn, DeleteResponse* response) const;
 
+  void DeleteRecursive(uint32_t group_id, const DeleteRecursiveRequest& request,
+                       const Transaction* txn,
+                       DeleteRecursiveResponse* response) const;
+
   void SetData(uint32_t group_id, const SetDataRequest& request,
                const Transaction* txn, SetDataResponse* response) const;
 
+  void Increment(uint32_t group_id, const IncrementRequest& request,
+                 const Transaction* txn, IncrementResponse* response) const;
+
   void SetACL(uint32_t group_id, const SetACLRequest& request,
               const Transaction* txn, SetACLResponse* response) const;
   bool CreateSession(uint32_t group_id, uint64_t session_id,
                      uint64_t new_version, uint64_t old_version) const;
   bool CloseSession(uint32_t group_id, uint64_t session_id,
                     uint64_t version) const;
-  void KillSession(uint32_t group_id, uint64_t session_id,
-                   const Transaction* txn) const;
+  void KillSessions(uint32_t group_id, const std::vector<uint64_t>& session_ids,
+                    const Transaction* txn) const;
+  void Cleanup(uint32_t group_id, const CleanupRequest& request,
+               const Transaction* txn) const;
 
   void MaybeMakeCheckpoint(uint32_t group_id, uint64_t instance_id);
-  void MakeCheckpoint(
+  // Return the size of the checkpoint.
+  size_t MakeCheckpoint(
       uint32_t group_id, uint64_t instance_id,
       std::unordered_map<std::string, DataNode>* nodes,
-      std::unordered_map<std::string, std::unordered_set<std::string>>*
+      std::unordered_map<std::string, std::set<std::string>>*
           childrens,
       std::unordered_map<uint64_t, uint64_t>* sessions);
-  void MakeCheckpoint(uint32_t group_id, uint64_t instance_id,
-                      const std::string& s);
+  size_t MakeCheckpoint(uint32_t group_id, uint64_t instance_id,
+                        const std::string& s);
+  void RecordCheckpoint(uint32_t group_id, uint64_t instance_id,
+                        uint64_t start_micros, size_t size);
   void CleanCheckpoint(uint32_t group_id);
 
   const uint32_t kKeepCheckpointCount;
@@ -123,7 +174,9 @@ class SaberDB : public skywalker::StateMachine, public skywalker::Checkpoint {
   std::atomic<bool> doing_;
 
   std::string checkpoint_storage_path_;
-  std::vector<uint64_t> checkpoint_id_;
+  std::unique_ptr<std::atomic<uint64_t>[]> checkpoint_id_;
+  std::unique_ptr<std::atomic<uint64_t>[]> checkpoint_time_;
+  std::unique_ptr<std::atomic<uint64_t>[]> applied_id_;
   std::vector<std::vector<uint64_t>> files_;
   std::vector<std::unique_ptr<DataTree>> trees_;
   std::vector<std::unique_ptr<SessionManager>> sessions_;
@@ -132,6 +185,8 @@ class SaberDB : public skywalker::StateMachine, public skywalker::Checkpoint {
   std::uniform_int_distribution<uint32_t> distribution_;
 
   RunLoop* loop_;
+  ServerMetrics* metrics_;
+  SlowOpLog* slow_ops_;
 
   // No copying allowed
   SaberDB(const SaberDB&);
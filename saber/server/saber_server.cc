@@ -3,8 +3,10 @@
 // found in the LICENSE file.
 
 #include "saber/server/saber_server.h"
+#include "saber/server/admin_server.h"
 #include "saber/server/saber_db.h"
 #include "saber/server/saber_session.h"
+#include "saber/server/server_metrics.h"
 #include "saber/util/logging.h"
 #include "saber/util/mutexlock.h"
 #include "saber/util/sequence_number.h"
@@ -44,11 +46,19 @@ SaberServer::SaberServer(voyager::EventLoop* loop, const ServerOptions& options)
       idle_ticks_(options_.session_timeout / options_.tick_time),
       mutexes_(options_.paxos_group_size),
       sessions_(options_.paxos_group_size),
+      masters_(new std::atomic<bool>[options_.paxos_group_size]),
+      metrics_(new ServerMetrics(&registry_)),
+      trace_count_(0),
+      traces_(options_.slow_trace_threshold, options_.slow_trace_count),
+      slow_ops_(options_),
       loop_(nullptr),
       monitor_(options.max_all_connections, options.max_ip_connections),
       server_(loop, voyager::SockAddr(options.my_server_message.host,
                                       options.my_server_message.client_port),
               "SaberServer", options.server_thread_size) {
+  for (uint32_t i = 0; i < options_.paxos_group_size; ++i) {
+    masters_[i] = false;
+  }
   codec_.SetMessageCallback(std::bind(&SaberServer::OnMessage, this,
                                       std::placeholders::_1,
                                       std::placeholders::_2));
@@ -61,7 +71,7 @@ SaberServer::~SaberServer() {}
 
 bool SaberServer::Start() {
   loop_ = thread_.Loop();
-  db_.reset(new SaberDB(loop_, options_));
+  db_.reset(new SaberDB(loop_, options_, metrics_.get(), &slow_ops_));
   db_->set_machine_id(10);
   bool res = db_->Recover();
   if (res) {
@@ -112,6 +122,7 @@ bool SaberServer::Start() {
     node_.reset(node);
 
     SaberSession::kMaxDataSize = options_.max_data_size;
+    SaberSession::kMaxOutputBufferSize = options_.max_output_buffer_size;
     for (uint32_t i = 0; i < options_.paxos_group_size; ++i) {
       loop_->QueueInLoop(std::bind(&SaberServer::CleanSessions, this, i));
     }
@@ -133,12 +144,121 @@ bool SaberServer::Start() {
       loop->RunEvery(options_.tick_time,
                      std::bind(&SaberServer::OnTimer, this));
     }
+    loop_->RunEvery(options_.cleanup_interval,
+                    std::bind(&SaberServer::CleanNodes, this));
+
+    if (options_.admin_port != 0) {
+      admin_.reset(new AdminServer(this, options_.my_server_message.host,
+                                   options_.admin_port));
+      admin_->Start();
+      LOG_INFO("Admin server listens on port %u.",
+               static_cast<unsigned>(options_.admin_port));
+    }
   } else {
     LOG_ERROR("Skywalker start failed!");
   }
   return res;
 }
 
+void SaberServer::GetMetrics(MetricsSnapshot* snapshot) {
+  registry_.GetSnapshot(snapshot);
+  for (uint32_t i = 0; i < options_.paxos_group_size; ++i) {
+    std::string prefix = "group." + std::to_string(i);
+    {
+      MutexLock lock(&mutexes_[i]);
+      snapshot->counters[prefix + ".sessions"] =
+          static_cast<int64_t>(sessions_[i].size());
+    }
+    if (db_) {
+      snapshot->counters[prefix + ".watches"] =
+          static_cast<int64_t>(db_->GetWatchCount(i));
+    }
+  }
+}
+
+void SaberServer::GetGroupStats(std::vector<GroupStats>* groups) {
+  groups->resize(options_.paxos_group_size);
+  for (uint32_t i = 0; i < options_.paxos_group_size; ++i) {
+    GroupStats& stats = (*groups)[i];
+    stats.group_id = i;
+    stats.master = masters_[i];
+    if (node_) {
+      skywalker::Member member;
+      uint64_t version;
+      node_->GetMaster(i, &member, &version);
+      if (!member.host.empty()) {
+        stats.master_addr = member.host + ":" + member.context;
+      }
+    }
+    {
+      MutexLock lock(&mutexes_[i]);
+      stats.sessions = sessions_[i].size();
+    }
+    if (db_) {
+      DataTree::Usage usage;
+      db_->GetTotalUsage(i, &usage);
+      stats.nodes = usage.nodes;
+      stats.bytes = usage.bytes;
+      stats.watches = db_->GetWatchCount(i);
+      stats.applied_instance_id = db_->GetAppliedInstanceId(i);
+      stats.checkpoint_instance_id = db_->GetCheckpointInstanceId(i);
+      stats.checkpoint_time = db_->GetCheckpointTime(i);
+    }
+  }
+}
+
+void SaberServer::GetRootStats(std::vector<RootStats>* roots) {
+  if (!db_) {
+    return;
+  }
+  for (uint32_t i = 0; i < options_.paxos_group_size; ++i) {
+    std::map<std::string, DataTree::Usage> usages;
+    db_->GetUsages(i, &usages);
+    for (auto& it : usages) {
+      RootStats stats;
+      stats.group_id = i;
+      stats.root = it.first;
+      stats.nodes = it.second.nodes;
+      stats.bytes = it.second.bytes;
+      roots->push_back(stats);
+    }
+  }
+}
+
+void SaberServer::GetSessionStats(std::vector<SessionStats>* sessions) {
+  for (uint32_t i = 0; i < options_.paxos_group_size; ++i) {
+    std::vector<std::shared_ptr<SaberSession>> v;
+    {
+      MutexLock lock(&mutexes_[i]);
+      v.reserve(sessions_[i].size());
+      for (auto& it : sessions_[i]) {
+        auto session = it.second.lock();
+        if (session) {
+          v.push_back(session);
+        }
+      }
+    }
+    // Don't hold the lock of the group while locking each session.
+    for (auto& session : v) {
+      SessionStats stats;
+      stats.session_id = session->session_id();
+      stats.group_id = i;
+      stats.pending_messages = session->PendingCount();
+      stats.buffered_bytes = session->BufferedBytes();
+      sessions->push_back(stats);
+    }
+  }
+}
+
+void SaberServer::GetSlowTraces(
+    std::vector<TraceRecorder::TraceRecord>* traces) {
+  traces_.GetTraces(traces);
+}
+
+void SaberServer::GetSlowOps(std::vector<SlowOp>* ops) {
+  slow_ops_.GetOps(ops);
+}
+
 void SaberServer::OnConnection(const voyager::TcpConnectionPtr& p) {
   bool result = monitor_.OnConnection(p);
   if (result) {
@@ -161,6 +281,7 @@ bool SaberServer::OnMessage(const voyager::TcpConnectionPtr& p,
   EntryPtr entry = (context->entry_wp).lock();
   bool b = false;
   if (entry) {
+    StartTrace(message.get());
     b = HandleMessage(entry, std::move(message));
     if (b) {
       UpdateBuckets(p, entry);
@@ -179,6 +300,22 @@ void SaberServer::OnError(const voyager::TcpConnectionPtr& p,
   LOG_WARN("proto codec error, the code is %d", code);
 }
 
+void SaberServer::StartTrace(SaberMessage* message) {
+  if (!message->has_trace()) {
+    if (options_.trace_sample_interval == 0 || message->type() == MT_PING) {
+      return;
+    }
+    uint64_t n = ++trace_count_;
+    if (n % options_.trace_sample_interval != 0) {
+      return;
+    }
+    // Keep the ids of the servers apart.
+    message->mutable_trace()->set_id(server_id_ << 48 |
+                                     (n & ((1ULL << 48) - 1)));
+  }
+  message->mutable_trace()->set_received_micros(NowMicros());
+}
+
 void SaberServer::OnTimer() {
   auto it = buckets_.find(voyager::EventLoop::RunLoop());
   assert(it != buckets_.end());
@@ -200,6 +337,13 @@ void SaberServer::UpdateBuckets(const voyager::TcpConnectionPtr& p,
 
 bool SaberServer::HandleMessage(const EntryPtr& entry,
                                 std::unique_ptr<SaberMessage> message) {
+  // The enums of proto3 are open, the unknown types mustn't be used as the
+  // indexes of the metrics and the thresholds.
+  if (!MessageType_IsValid(message->type())) {
+    LOG_WARN("Invalid message type %d, close the connection.",
+             static_cast<int>(message->type()));
+    return false;
+  }
   if (message->type() != MT_CONNECT) {
     if (entry->session) {
       assert(entry->session->GetTcpConnectionPtr() == entry->conn_wp.lock());
@@ -344,7 +488,10 @@ bool SaberServer::CreateSession(const std::string& root, uint32_t group_id,
     b = false;
     entry->session = std::make_shared<SaberSession>(root, group_id, session_id,
                                                     entry->conn_wp.lock(),
-                                                    db_.get(), node_.get());
+                                                    db_.get(), node_.get(),
+                                                    &masters_[group_id],
+                                                    metrics_.get(), &traces_,
+                                                    &slow_ops_);
     sessions_[group_id].insert(std::make_pair(session_id, entry->session));
   }
   entry->session->set_version(version);
@@ -374,6 +521,7 @@ void SaberServer::CleanSessions(uint32_t group_id) {
   if (!node_) {
     return;
   }
+  masters_[group_id] = node_->IsMaster(group_id);
   if (!node_->IsMaster(group_id)) {
     MutexLock lock(&mutexes_[group_id]);
     for (auto& it : sessions_[group_id]) {
@@ -409,6 +557,49 @@ void SaberServer::CleanSessions(uint32_t group_id) {
   });
 }
 
+void SaberServer::CleanNodes() {
+  // The max count of paths in one cleanup proposal.
+  static const size_t kMaxCleanupPaths = 1000;
+
+  uint64_t now = NowMillis();
+  std::vector<std::string> paths;
+  for (uint32_t i = 0; i < options_.paxos_group_size; ++i) {
+    if (!node_->IsMaster(i)) {
+      continue;
+    }
+    paths.clear();
+    db_->GetExpiredNodes(i, now, &paths);
+    db_->GetEmptyContainers(i, &paths);
+    CleanupRequest request;
+    for (auto& path : paths) {
+      request.add_path(path);
+      if (static_cast<size_t>(request.path_size()) == kMaxCleanupPaths) {
+        OnCleanupRequest(i, request, now);
+        request.Clear();
+      }
+    }
+    if (request.path_size() > 0) {
+      OnCleanupRequest(i, request, now);
+    }
+  }
+}
+
+void SaberServer::OnCleanupRequest(uint32_t group_id,
+                                   const CleanupRequest& request,
+                                   uint64_t now) {
+  Transaction txn;
+  txn.set_time(now);
+  SaberMessage message;
+  message.set_type(MT_CLEANUP);
+  message.set_data(request.SerializeAsString());
+  message.set_extra_data(txn.SerializeAsString());
+  node_->Propose(
+      group_id, db_->machine_id(), message.SerializeAsString(), nullptr,
+      [group_id](uint64_t, const skywalker::Status& s, void*) {
+        LOG_INFO("Group %u: cleanup nodes:%s", group_id, s.ToString().c_str());
+      });
+}
+
 void SaberServer::NewServers(uint32_t group_id) {
   if (!node_) {
     return;
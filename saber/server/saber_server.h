@@ -5,6 +5,10 @@
 #ifndef SABER_SERVER_SABER_SERVER_H_
 #define SABER_SERVER_SABER_SERVER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -23,18 +27,67 @@
 #include <voyager/util/hash.h>
 
 #include "saber/proto/saber.pb.h"
+#include "saber/proto/server.pb.h"
 #include "saber/server/server_options.h"
+#include "saber/server/slow_op_log.h"
+#include "saber/server/trace_recorder.h"
+#include "saber/util/metrics.h"
 #include "saber/util/mutex.h"
 #include "saber/util/runloop.h"
 #include "saber/util/runloop_thread.h"
 
 namespace saber {
 
+class AdminServer;
 class SaberDB;
 class SaberSession;
+struct ServerMetrics;
 
 class SaberServer {
  public:
+  struct GroupStats {
+    GroupStats()
+        : group_id(0),
+          master(false),
+          applied_instance_id(UINTMAX_MAX),
+          nodes(0),
+          bytes(0),
+          watches(0),
+          sessions(0),
+          checkpoint_instance_id(UINTMAX_MAX),
+          checkpoint_time(0) {}
+    uint32_t group_id;
+    bool master;
+    // The host and the client port of the master, empty if it is unknown.
+    std::string master_addr;
+    uint64_t applied_instance_id;
+    uint64_t nodes;
+    uint64_t bytes;
+    size_t watches;
+    size_t sessions;
+    uint64_t checkpoint_instance_id;
+    uint64_t checkpoint_time;
+  };
+
+  struct SessionStats {
+    SessionStats()
+        : session_id(0), group_id(0), pending_messages(0), buffered_bytes(0) {}
+    uint64_t session_id;
+    uint32_t group_id;
+    size_t pending_messages;
+    size_t buffered_bytes;
+  };
+
+  // The usage of a root, which is limited by max_root_nodes and
+  // max_root_bytes.
+  struct RootStats {
+    RootStats() : group_id(0), nodes(0), bytes(0) {}
+    uint32_t group_id;
+    std::string root;
+    uint64_t nodes;
+    uint64_t bytes;
+  };
+
   SaberServer(voyager::EventLoop* loop, const ServerOptions& options);
   ~SaberServer();
 
@@ -42,6 +95,22 @@ class SaberServer {
 
   const skywalker::Node* GetNode() const { return node_.get(); }
 
+  // Get all the metrics, including the count of the sessions connected to
+  // this server and the count of the watches of each group.
+  void GetMetrics(MetricsSnapshot* snapshot);
+
+  // Get the stats of each group, each root and each session, they can be
+  // got in any thread after Start.
+  void GetGroupStats(std::vector<GroupStats>* groups);
+  void GetRootStats(std::vector<RootStats>* roots);
+  void GetSessionStats(std::vector<SessionStats>* sessions);
+
+  // Get the latest slow traces, the oldest first.
+  void GetSlowTraces(std::vector<TraceRecorder::TraceRecord>* traces);
+
+  // Get the latest slow ops, the oldest first.
+  void GetSlowOps(std::vector<SlowOp>* ops);
+
  private:
   struct Context;
   struct Entry;
@@ -57,6 +126,9 @@ class SaberServer {
   void OnError(const voyager::TcpConnectionPtr& p,
                voyager::ProtoCodecError code);
   void OnTimer();
+  // Stamp the received time if the message is traced by the client or
+  // sampled by the server.
+  void StartTrace(SaberMessage* message);
   void UpdateBuckets(const voyager::TcpConnectionPtr& p, const EntryPtr& entry);
   bool HandleMessage(const EntryPtr& p, std::unique_ptr<SaberMessage> message);
   bool OnConnectRequest(const std::string& root, uint32_t group_id,
@@ -70,6 +142,9 @@ class SaberServer {
                      const EntryPtr& entry);
   void CloseSession(const std::shared_ptr<SaberSession>& session);
   void CleanSessions(uint32_t group_id);
+  void CleanNodes();
+  void OnCleanupRequest(uint32_t group_id, const CleanupRequest& request,
+                        uint64_t now);
 
   void NewServers(uint32_t group_id);
 
@@ -93,6 +168,17 @@ class SaberServer {
   std::vector<Mutex> mutexes_;
   std::vector<SessionMap> sessions_;
 
+  // Whether this server is the master of each group, it is updated in
+  // CleanSessions after the master changed.
+  std::unique_ptr<std::atomic<bool>[]> masters_;
+
+  MetricsRegistry registry_;
+  std::unique_ptr<ServerMetrics> metrics_;
+
+  std::atomic<uint64_t> trace_count_;
+  TraceRecorder traces_;
+  SlowOpLog slow_ops_;
+
   std::unique_ptr<SaberDB> db_;
   std::unique_ptr<skywalker::Node> node_;
 
@@ -103,6 +189,8 @@ class SaberServer {
   voyager::TcpMonitor monitor_;
   voyager::TcpServer server_;
 
+  std::unique_ptr<AdminServer> admin_;
+
   // No copying allowed
   SaberServer(const SaberServer&);
   void operator=(const SaberServer&);
@@ -6,6 +6,9 @@
 
 #include <voyager/core/eventloop.h>
 
+#include "saber/server/server_metrics.h"
+#include "saber/server/slow_op_log.h"
+#include "saber/server/trace_recorder.h"
 #include "saber/util/logging.h"
 #include "saber/util/mutexlock.h"
 #include "saber/util/timeops.h"
@@ -13,6 +16,7 @@
 namespace saber {
 
 uint32_t SaberSession::kMaxDataSize = 1024 * 1024;
+uint32_t SaberSession::kMaxOutputBufferSize = 4 * 1024 * 1024;
 
 static std::string GetRoot(const std::string& path) {
   size_t i = 0;
@@ -28,7 +32,10 @@ static std::string GetRoot(const std::string& path) {
 SaberSession::SaberSession(const std::string& root, uint32_t group_id,
                            uint64_t session_id,
                            const voyager::TcpConnectionPtr& p, SaberDB* db,
-                           skywalker::Node* node)
+                           skywalker::Node* node,
+                           const std::atomic<bool>* master,
+                           ServerMetrics* metrics, TraceRecorder* traces,
+                           SlowOpLog* slow_ops)
     : kRoot(root),
       group_id_(group_id),
       session_id_(session_id),
@@ -37,7 +44,22 @@ SaberSession::SaberSession(const std::string& root, uint32_t group_id,
       last_finished_(true),
       conn_wp_(p),
       db_(db),
-      node_(node) {}
+      node_(node),
+      master_(master),
+      metrics_(metrics),
+      traces_(traces),
+      slow_ops_(slow_ops),
+      type_(MT_PING),
+      received_micros_(0),
+      started_micros_(0),
+      checked_micros_(0),
+      proposed_micros_(0),
+      committed_micros_(0),
+      lock_wait_micros_(0),
+      request_bytes_(0),
+      notifications_(std::make_shared<Notifications>()) {
+  SetUpConnection(p);
+}
 
 SaberSession::~SaberSession() { db_->RemoveWatcher(group_id_, this); }
 
@@ -46,15 +68,25 @@ void SaberSession::OnConnect(const voyager::TcpConnectionPtr& p) {
   closed_ = false;
   conn_wp_ = p;
   pending_messages_.clear();
+  SetUpConnection(p);
 }
 
 bool SaberSession::OnMessage(std::unique_ptr<SaberMessage> message) {
   if (closed_) {
     return false;
   }
-  // No need to check master when the pending_messages_ is not empty.
-  if (message->type() == MT_PING && !pending_messages_.empty()) {
-    return true;
+  uint64_t now = NowMonotonicMicros();
+  if (message->type() == MT_PING) {
+    // The ping only keeps the session alive, and SaberServer::OnMessage
+    // has refreshed its bucket, so it needn't be replied or wait for the
+    // pending messages on the master.
+    if (master_->load(std::memory_order_relaxed)) {
+      return true;
+    }
+    // No need to check master when the pending_messages_ is not empty.
+    if (!pending_messages_.empty()) {
+      return true;
+    }
   }
 
   if (message->type() == MT_CLOSE) {
@@ -74,19 +106,35 @@ bool SaberSession::OnMessage(std::unique_ptr<SaberMessage> message) {
       if (message->type() == MT_MASTER) {
         pending_messages_.clear();
       }
-      pending_messages_.push_back(std::move(message));
+      pending_messages_.push_back(std::make_pair(std::move(message), now));
     }
   }
   if (next) {
-    HandleMessage(std::move(message));
+    HandleMessage(std::move(message), now);
   }
   return true;
 }
 
-void SaberSession::HandleMessage(std::unique_ptr<SaberMessage> message) {
+void SaberSession::HandleMessage(std::unique_ptr<SaberMessage> message,
+                                 uint64_t received_micros) {
+  type_ = message->type();
+  received_micros_ = received_micros;
+  started_micros_ = NowMonotonicMicros();
+  checked_micros_ = 0;
+  proposed_micros_ = 0;
+  committed_micros_ = 0;
+  lock_wait_micros_ = 0;
+  request_bytes_ = message->data().size();
+  path_.clear();
+  if (message->has_trace()) {
+    message->mutable_trace()->set_started_micros(NowMicros());
+  }
   if (message->type() != MT_MASTER && node_->IsMaster(group_id_)) {
+    ServerMetrics::Record(metrics_->queue_micros[type_],
+                          started_micros_ - received_micros_);
     DoIt(std::move(message));
   } else {
+    metrics_->redirects->Increment();
     skywalker::Member i;
     uint64_t version;
     node_->GetMaster(group_id_, &i, &version);
@@ -101,6 +149,7 @@ void SaberSession::HandleMessage(std::unique_ptr<SaberMessage> message) {
 
 void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
   bool done = true;
+  uint64_t wait_micros = Mutex::WaitMicros();
   switch (message->type()) {
     case MT_PING: {
       break;
@@ -109,6 +158,7 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       ExistsRequest request;
       ExistsResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       assert(GetRoot(request.path()) == kRoot);
       Watcher* watcher = request.watch() ? this : nullptr;
       db_->Exists(group_id_, request, watcher, &response);
@@ -119,6 +169,7 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       GetDataRequest request;
       GetDataResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       assert(GetRoot(request.path()) == kRoot);
       Watcher* watcher = request.watch() ? this : nullptr;
       db_->GetData(group_id_, request, watcher, &response);
@@ -129,6 +180,7 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       GetACLRequest request;
       GetACLResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       assert(GetRoot(request.path()) == kRoot);
       db_->GetACL(group_id_, request, &response);
       message->set_data(response.SerializeAsString());
@@ -138,16 +190,29 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       GetChildrenRequest request;
       GetChildrenResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       assert(GetRoot(request.path()) == kRoot);
       Watcher* watcher = request.watch() ? this : nullptr;
       db_->GetChildren(group_id_, request, watcher, &response);
       message->set_data(response.SerializeAsString());
       break;
     }
+    case MT_GETCHILDRENDELTA: {
+      GetChildrenDeltaRequest request;
+      GetChildrenDeltaResponse response;
+      request.ParseFromString(message->data());
+      path_ = request.path();
+      assert(GetRoot(request.path()) == kRoot);
+      Watcher* watcher = request.watch() ? this : nullptr;
+      db_->GetChildrenDelta(group_id_, request, watcher, &response);
+      message->set_data(response.SerializeAsString());
+      break;
+    }
     case MT_CREATE: {
       CreateRequest request;
       CreateResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       if (GetRoot(request.path()) != kRoot) {
         SetFailedState(message.get());
         break;
@@ -164,6 +229,7 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       DeleteRequest request;
       DeleteResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       if (GetRoot(request.path()) != kRoot) {
         SetFailedState(message.get());
         break;
@@ -176,10 +242,28 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       }
       break;
     }
+    case MT_DELETERECURSIVE: {
+      DeleteRecursiveRequest request;
+      DeleteRecursiveResponse response;
+      request.ParseFromString(message->data());
+      path_ = request.path();
+      if (GetRoot(request.path()) != kRoot) {
+        SetFailedState(message.get());
+        break;
+      }
+      db_->CheckDeleteRecursive(group_id_, request, &response);
+      if (response.code() != RC_OK) {
+        message->set_data(response.SerializeAsString());
+      } else {
+        done = false;
+      }
+      break;
+    }
     case MT_SETDATA: {
       SetDataRequest request;
       SetDataResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       if (GetRoot(request.path()) != kRoot ||
           request.data().size() > kMaxDataSize) {
         SetFailedState(message.get());
@@ -193,10 +277,28 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       }
       break;
     }
+    case MT_INCREMENT: {
+      IncrementRequest request;
+      IncrementResponse response;
+      request.ParseFromString(message->data());
+      path_ = request.path();
+      if (GetRoot(request.path()) != kRoot) {
+        SetFailedState(message.get());
+        break;
+      }
+      db_->CheckIncrement(group_id_, request, &response);
+      if (response.code() != RC_OK) {
+        message->set_data(response.SerializeAsString());
+      } else {
+        done = false;
+      }
+      break;
+    }
     case MT_SETACL: {
       SetACLRequest request;
       SetACLResponse response;
       request.ParseFromString(message->data());
+      path_ = request.path();
       if (GetRoot(request.path()) != kRoot) {
         SetFailedState(message.get());
         break;
@@ -219,6 +321,13 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
       break;
     }
   }
+  checked_micros_ = NowMonotonicMicros();
+  lock_wait_micros_ = Mutex::WaitMicros() - wait_micros;
+  ServerMetrics::Record(metrics_->doit_micros[type_],
+                        checked_micros_ - started_micros_);
+  if (message->has_trace()) {
+    message->mutable_trace()->set_checked_micros(NowMicros());
+  }
   if (done) {
     Done(std::move(message));
   } else {
@@ -229,16 +338,30 @@ void SaberSession::DoIt(std::unique_ptr<SaberMessage> message) {
 void SaberSession::Done(std::unique_ptr<SaberMessage> reply_message) {
   voyager::TcpConnectionPtr p = conn_wp_.lock();
   if (reply_message->type() != MT_PING) {
+    if (reply_message->has_trace()) {
+      FinishTrace(reply_message.get());
+    }
+    uint64_t start = NowMonotonicMicros();
     codec_.SendMessage(p, *reply_message);
+    if (reply_message->type() == type_) {
+      uint64_t end = NowMonotonicMicros();
+      ServerMetrics::Record(metrics_->send_micros[type_], end - start);
+      ServerMetrics::Record(metrics_->total_micros[type_],
+                            end - received_micros_);
+      if (slow_ops_->IsSlowRequest(type_, end - received_micros_)) {
+        AddSlowOp(*reply_message, end - start, end - received_micros_);
+      }
+    }
   }
 
-  SaberMessage* next = nullptr;
+  std::pair<SaberMessage*, uint64_t> next(nullptr, 0);
   {
     MutexLock lock(&mutex_);
     if (p && reply_message->type() != MT_MASTER &&
         reply_message->type() != MT_CLOSE) {
       if (!pending_messages_.empty()) {
-        next = pending_messages_.front().release();
+        next.first = pending_messages_.front().first.release();
+        next.second = pending_messages_.front().second;
         pending_messages_.pop_front();
       }
     } else {
@@ -248,14 +371,15 @@ void SaberSession::Done(std::unique_ptr<SaberMessage> reply_message) {
         p->ForceClose();
       }
     }
-    if (!next) {
+    if (!next.first) {
       last_finished_ = true;
     }
   }
-  if (next) {
+  if (next.first) {
     // FIXME
-    p->OwnerEventLoop()->QueueInLoop(
-        [this, next]() { HandleMessage(std::unique_ptr<SaberMessage>(next)); });
+    p->OwnerEventLoop()->QueueInLoop([this, next]() {
+      HandleMessage(std::unique_ptr<SaberMessage>(next.first), next.second);
+    });
   }
 }
 
@@ -265,6 +389,10 @@ void SaberSession::Propose(std::unique_ptr<SaberMessage> message) {
   txn.set_time(NowMillis());
   SaberMessage* reply = message.release();
   reply->set_extra_data(txn.SerializeAsString());
+  proposed_micros_ = NowMonotonicMicros();
+  if (reply->has_trace()) {
+    reply->mutable_trace()->set_proposed_micros(NowMicros());
+  }
   bool b = node_->Propose(
       group_id_, db_->machine_id(), reply->SerializeAsString(), reply,
       std::bind(&SaberSession::WeakCallback,
@@ -288,6 +416,13 @@ void SaberSession::WeakCallback(std::weak_ptr<SaberSession> session_wp,
     if (!s.ok()) {
       SetFailedState(reply_message);
     }
+    if (reply_message->has_trace()) {
+      reply_message->mutable_trace()->set_committed_micros(NowMicros());
+    }
+    session->committed_micros_ = NowMonotonicMicros();
+    ServerMetrics::Record(
+        session->metrics_->commit_micros[session->type_],
+        session->committed_micros_ - session->proposed_micros_);
     reply_message->clear_extra_data();
     LOG_DEBUG("Group %u: session(id=%llu) propose:%s", session->group_id_,
               (unsigned long long)session->session_id_, s.ToString().c_str());
@@ -297,6 +432,40 @@ void SaberSession::WeakCallback(std::weak_ptr<SaberSession> session_wp,
   }
 }
 
+void SaberSession::FinishTrace(SaberMessage* reply_message) {
+  Trace* trace = reply_message->mutable_trace();
+  trace->set_sent_micros(NowMicros());
+  traces_->Add(group_id_, session_id_, type_, *trace);
+  // The traces sampled by the server are not sent to the client.
+  if (trace->client_send_micros() == 0) {
+    reply_message->clear_trace();
+  }
+}
+
+void SaberSession::AddSlowOp(const SaberMessage& reply_message,
+                             uint64_t send_micros, uint64_t total_micros) {
+  SlowOp op;
+  op.type = SlowOp::kRequest;
+  op.message_type = type_;
+  op.group_id = group_id_;
+  op.session_id = session_id_;
+  op.time = NowMicros();
+  op.total_micros = total_micros;
+  op.queue_micros = started_micros_ - received_micros_;
+  if (checked_micros_ != 0) {
+    op.doit_micros = checked_micros_ - started_micros_;
+  }
+  if (committed_micros_ != 0) {
+    op.commit_micros = committed_micros_ - proposed_micros_;
+  }
+  op.send_micros = send_micros;
+  op.lock_wait_micros = lock_wait_micros_;
+  op.request_bytes = request_bytes_;
+  op.reply_bytes = reply_message.data().size();
+  op.set_path(path_);
+  slow_ops_->Add(op);
+}
+
 void SaberSession::SetFailedState(SaberMessage* reply_message) {
   switch (reply_message->type()) {
     case MT_CREATE: {
@@ -311,12 +480,24 @@ void SaberSession::SetFailedState(SaberMessage* reply_message) {
       reply_message->set_data(response.SerializeAsString());
       break;
     }
+    case MT_DELETERECURSIVE: {
+      DeleteRecursiveResponse response;
+      response.set_code(RC_FAILED);
+      reply_message->set_data(response.SerializeAsString());
+      break;
+    }
     case MT_SETDATA: {
       SetDataResponse response;
       response.set_code(RC_FAILED);
       reply_message->set_data(response.SerializeAsString());
       break;
     }
+    case MT_INCREMENT: {
+      IncrementResponse response;
+      response.set_code(RC_FAILED);
+      reply_message->set_data(response.SerializeAsString());
+      break;
+    }
     case MT_SETACL: {
       SetACLResponse response;
       response.set_code(RC_FAILED);
@@ -338,10 +519,121 @@ void SaberSession::SetFailedState(SaberMessage* reply_message) {
 }
 
 void SaberSession::Process(const WatchedEvent& event) {
+  voyager::TcpConnectionPtr p = conn_wp_.lock();
+  if (!p) {
+    return;
+  }
+  bool flush;
+  {
+    MutexLock lock(&notifications_->mutex);
+    if (notifications_->resync) {
+      return;
+    }
+    flush = notifications_->events.empty();
+    notifications_->events.push_back(event);
+  }
+  // The events triggered before the flush task runs at the end of this
+  // loop iteration are sent together.
+  if (flush) {
+    std::shared_ptr<Notifications> n = notifications_;
+    p->OwnerEventLoop()->QueueInLoop([n, p]() { FlushNotifications(n, p); });
+  }
+}
+
+void SaberSession::FlushNotifications(const std::shared_ptr<Notifications>& n,
+                                      const voyager::TcpConnectionPtr& p) {
+  std::vector<WatchedEvent> events;
+  {
+    MutexLock lock(&n->mutex);
+    events.swap(n->events);
+  }
+  if (events.empty()) {
+    return;
+  }
+  SaberMessage message;
+  if (events.size() == 1) {
+    message.set_type(MT_NOTIFICATION);
+    message.set_data(events.front().SerializeAsString());
+  } else {
+    WatchedEvents batch;
+    for (auto& event : events) {
+      batch.add_events()->Swap(&event);
+    }
+    message.set_type(MT_NOTIFICATIONS);
+    message.set_data(batch.SerializeAsString());
+  }
+  n->codec.SendMessage(p, message);
+}
+
+void SaberSession::OnHighWaterMark(const std::shared_ptr<Notifications>& n,
+                                   const voyager::TcpConnectionPtr& p,
+                                   size_t size) {
+  n->buffered_bytes.store(size, std::memory_order_relaxed);
+  p->StopRead();
+  {
+    MutexLock lock(&n->mutex);
+    if (n->resync) {
+      return;
+    }
+    n->resync = true;
+    n->events.clear();
+  }
+  LOG_WARN("The output buffer of connection %s is full, stop reading.",
+           p->name().c_str());
+  WatchedEvent event;
+  event.set_state(SS_CONNECTED);
+  event.set_type(ET_RESYNC);
   SaberMessage message;
   message.set_type(MT_NOTIFICATION);
   message.set_data(event.SerializeAsString());
-  codec_.SendMessage(conn_wp_.lock(), message);
+  n->codec.SendMessage(p, message);
+}
+
+void SaberSession::OnWriteComplete(const std::shared_ptr<Notifications>& n,
+                                   const voyager::TcpConnectionPtr& p) {
+  n->buffered_bytes.store(0, std::memory_order_relaxed);
+  {
+    MutexLock lock(&n->mutex);
+    if (!n->resync) {
+      return;
+    }
+    n->resync = false;
+  }
+  LOG_INFO("The output buffer of connection %s is drained, start reading.",
+           p->name().c_str());
+  p->StartRead();
+}
+
+void SaberSession::SetUpConnection(const voyager::TcpConnectionPtr& p) {
+  if (!p) {
+    return;
+  }
+  std::shared_ptr<Notifications> n = notifications_;
+  p->SetHighWaterMarkCallback(
+      [n](const voyager::TcpConnectionPtr& c, size_t size) {
+        OnHighWaterMark(n, c, size);
+      },
+      kMaxOutputBufferSize);
+  p->SetWriteCompleteCallback(
+      [n](const voyager::TcpConnectionPtr& c) { OnWriteComplete(n, c); });
+}
+
+size_t SaberSession::BufferedBytes() const {
+  std::shared_ptr<Notifications> n = notifications_;
+  voyager::TcpConnectionPtr p = conn_wp_.lock();
+  if (p) {
+    // The output buffer is only touched by the loop of the connection.
+    p->OwnerEventLoop()->RunInLoop([n, p]() {
+      n->buffered_bytes.store(p->OutputBuffer()->ReadableSize(),
+                              std::memory_order_relaxed);
+    });
+  }
+  return n->buffered_bytes.load(std::memory_order_relaxed);
+}
+
+size_t SaberSession::PendingCount() {
+  MutexLock lock(&mutex_);
+  return pending_messages_.size();
 }
 
 }  // namespace saber
@@ -5,9 +5,12 @@
 #ifndef SABER_SERVER_SABER_SESSION_H_
 #define SABER_SERVER_SABER_SESSION_H_
 
+#include <atomic>
 #include <deque>
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <skywalker/node.h>
 
@@ -21,14 +24,25 @@
 
 namespace saber {
 
+struct ServerMetrics;
+class SlowOpLog;
+class TraceRecorder;
+
 class SaberSession : public Watcher,
                      public std::enable_shared_from_this<SaberSession> {
  public:
   static uint32_t kMaxDataSize;
+  static uint32_t kMaxOutputBufferSize;
 
+  // The master is the cached flag of whether this server is the master of
+  // the group, which is used to answer the pings on the IO thread. The
+  // slow traces of the requests are added to the traces, and the slow
+  // requests to the slow_ops.
   SaberSession(const std::string& root, uint32_t group_id, uint64_t session_id,
                const voyager::TcpConnectionPtr& p, SaberDB* db,
-               skywalker::Node* node);
+               skywalker::Node* node, const std::atomic<bool>* master,
+               ServerMetrics* metrics, TraceRecorder* traces,
+               SlowOpLog* slow_ops);
   virtual ~SaberSession();
 
   uint32_t group_id() const { return group_id_; }
@@ -47,13 +61,52 @@ class SaberSession : public Watcher,
 
   virtual void Process(const WatchedEvent& event);
 
+  // The bytes waiting to be sent to the client, only for stats. The output
+  // buffer is sampled on the loop of the connection, so the value may be
+  // the one sampled by the previous call.
+  size_t BufferedBytes() const;
+
+  // The count of the messages waiting to be handled, only for stats.
+  size_t PendingCount();
+
  private:
+  // The watched events waiting to be sent in one frame. It is shared with
+  // the flush task, which may run after the session has gone.
+  struct Notifications {
+    Notifications() : resync(false), buffered_bytes(0) {}
+    Mutex mutex;
+    std::vector<WatchedEvent> events;
+    // Whether the output buffer has crossed the high-water mark, the events
+    // are dropped until it is drained.
+    bool resync;
+    // The last sampled size of the output buffer. It is set by the IO
+    // thread, so that the buffer itself needn't be read by the other
+    // threads.
+    std::atomic<size_t> buffered_bytes;
+    voyager::ProtobufCodec<SaberMessage> codec;
+  };
+
+  static void FlushNotifications(const std::shared_ptr<Notifications>& n,
+                                 const voyager::TcpConnectionPtr& p);
+  static void OnHighWaterMark(const std::shared_ptr<Notifications>& n,
+                              const voyager::TcpConnectionPtr& p,
+                              size_t size);
+  static void OnWriteComplete(const std::shared_ptr<Notifications>& n,
+                              const voyager::TcpConnectionPtr& p);
+
+  void SetUpConnection(const voyager::TcpConnectionPtr& p);
   static void WeakCallback(std::weak_ptr<SaberSession> session_wp,
                            uint64_t instance_id, const skywalker::Status& s,
                            void* context);
   static void SetFailedState(SaberMessage* reply_message);
 
-  void HandleMessage(std::unique_ptr<SaberMessage> message);
+  // Stamp the sent time and keep the trace if it is slow.
+  void FinishTrace(SaberMessage* reply_message);
+  void AddSlowOp(const SaberMessage& reply_message, uint64_t send_micros,
+                 uint64_t total_micros);
+
+  void HandleMessage(std::unique_ptr<SaberMessage> message,
+                     uint64_t received_micros);
   void DoIt(std::unique_ptr<SaberMessage> message);
   void Done(std::unique_ptr<SaberMessage> message);
   void Propose(std::unique_ptr<SaberMessage> message);
@@ -71,9 +124,30 @@ class SaberSession : public Watcher,
   std::weak_ptr<voyager::TcpConnection> conn_wp_;
   SaberDB* db_;
   skywalker::Node* node_;
+  const std::atomic<bool>* master_;
+  ServerMetrics* metrics_;
+  TraceRecorder* traces_;
+  SlowOpLog* slow_ops_;
+
+  // The times of the message being handled, only one message of the
+  // session is handled at a time.
+  MessageType type_;
+  uint64_t received_micros_;
+  uint64_t started_micros_;
+  uint64_t checked_micros_;
+  uint64_t proposed_micros_;
+  uint64_t committed_micros_;
+  // Only for the slow-op log.
+  uint64_t lock_wait_micros_;
+  size_t request_bytes_;
+  std::string path_;
 
   Mutex mutex_;
-  std::deque<std::unique_ptr<SaberMessage>> pending_messages_;
+  // The messages and the times they were received.
+  std::deque<std::pair<std::unique_ptr<SaberMessage>, uint64_t>>
+      pending_messages_;
+
+  std::shared_ptr<Notifications> notifications_;
 
   // No copying allowed
   SaberSession(const SaberSession&);
@@ -0,0 +1,65 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "saber/server/server_metrics.h"
+
+#include <ctype.h>
+
+#include <string>
+
+namespace saber {
+
+// MT_CREATE => "create"
+static std::string TypeName(MessageType type) {
+  std::string name = MessageType_Name(type).substr(3);
+  for (auto& c : name) {
+    c = static_cast<char>(tolower(c));
+  }
+  return name;
+}
+
+ServerMetrics::ServerMetrics(MetricsRegistry* registry)
+    : redirects(registry->GetCounter("session.redirects")),
+      checkpoint_micros(registry->GetHistogram("checkpoint.micros")),
+      checkpoint_bytes(registry->GetHistogram("checkpoint.bytes")),
+      checkpoint_failures(registry->GetCounter("checkpoint.failures")) {
+  static const MessageType kReads[] = {MT_EXISTS, MT_GETDATA, MT_GETACL,
+                                       MT_GETCHILDREN, MT_GETCHILDRENDELTA};
+  static const MessageType kWrites[] = {
+      MT_CREATE, MT_DELETE, MT_DELETERECURSIVE, MT_SETDATA,
+      MT_INCREMENT, MT_SETACL, MT_CLOSE};
+  static const MessageType kApplies[] = {MT_CONNECT, MT_CLEANUP};
+
+  for (int i = 0; i < MessageType_ARRAYSIZE; ++i) {
+    queue_micros[i] = nullptr;
+    doit_micros[i] = nullptr;
+    commit_micros[i] = nullptr;
+    send_micros[i] = nullptr;
+    total_micros[i] = nullptr;
+    apply_micros[i] = nullptr;
+  }
+  for (auto& type : kReads) {
+    std::string prefix = "session." + TypeName(type);
+    queue_micros[type] = registry->GetHistogram(prefix + ".queue_micros");
+    doit_micros[type] = registry->GetHistogram(prefix + ".doit_micros");
+    send_micros[type] = registry->GetHistogram(prefix + ".send_micros");
+    total_micros[type] = registry->GetHistogram(prefix + ".total_micros");
+  }
+  for (auto& type : kWrites) {
+    std::string prefix = "session." + TypeName(type);
+    queue_micros[type] = registry->GetHistogram(prefix + ".queue_micros");
+    doit_micros[type] = registry->GetHistogram(prefix + ".doit_micros");
+    commit_micros[type] = registry->GetHistogram(prefix + ".commit_micros");
+    send_micros[type] = registry->GetHistogram(prefix + ".send_micros");
+    total_micros[type] = registry->GetHistogram(prefix + ".total_micros");
+    apply_micros[type] =
+        registry->GetHistogram("db." + TypeName(type) + ".apply_micros");
+  }
+  for (auto& type : kApplies) {
+    apply_micros[type] =
+        registry->GetHistogram("db." + TypeName(type) + ".apply_micros");
+  }
+}
+
+}  // namespace saber
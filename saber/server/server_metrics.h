@@ -0,0 +1,48 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_SERVER_SERVER_METRICS_H_
+#define SABER_SERVER_SERVER_METRICS_H_
+
+#include <stdint.h>
+
+#include "saber/proto/saber.pb.h"
+#include "saber/util/metrics.h"
+
+namespace saber {
+
+// The metrics of the server, which are created in the registry at once so
+// that the hot paths needn't look them up. The histograms of the message
+// types which don't go through the path are nullptr.
+struct ServerMetrics {
+  explicit ServerMetrics(MetricsRegistry* registry);
+
+  static void Record(Histogram* histogram, uint64_t value) {
+    if (histogram != nullptr) {
+      histogram->Record(value);
+    }
+  }
+
+  // The latency of the requests of SaberSession in microseconds, which is
+  // split into waiting behind the previous requests of the session, DoIt,
+  // proposing until committed for the writes and sending the reply.
+  Histogram* queue_micros[MessageType_ARRAYSIZE];
+  Histogram* doit_micros[MessageType_ARRAYSIZE];
+  Histogram* commit_micros[MessageType_ARRAYSIZE];
+  Histogram* send_micros[MessageType_ARRAYSIZE];
+  Histogram* total_micros[MessageType_ARRAYSIZE];
+  // The requests sent to the master as this server is not.
+  Counter* redirects;
+
+  // The time of applying the committed values in SaberDB::Execute.
+  Histogram* apply_micros[MessageType_ARRAYSIZE];
+
+  Histogram* checkpoint_micros;
+  Histogram* checkpoint_bytes;
+  Counter* checkpoint_failures;
+};
+
+}  // namespace saber
+
+#endif  // SABER_SERVER_SERVER_METRICS_H_
@@ -16,13 +16,23 @@ ServerOptions::ServerOptions()
       paxos_group_size(10),
       tick_time(3000000),
       session_timeout(4 * tick_time),
+      cleanup_interval(1000000),
       max_all_connections(60000),
       max_ip_connections(60),
       max_data_size(1024 * 1024),
+      max_output_buffer_size(4 * 1024 * 1024),
+      max_root_nodes(0),
+      max_root_bytes(0),
       keep_log_count(1000000),
       log_sync_interval(10),
       keep_checkpoint_count(3),
       make_checkpoint_interval(200000),
-      async_serialize_checkpoint_data(true) {}
+      async_serialize_checkpoint_data(true),
+      admin_port(0),
+      trace_sample_interval(0),
+      slow_trace_threshold(100000),
+      slow_trace_count(128),
+      slow_op_threshold(100000),
+      slow_op_count(256) {}
 
 }  // namespace saber
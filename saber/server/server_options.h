@@ -6,6 +6,7 @@
 #define SABER_SERVER_SERVER_OPTIONS_H_
 
 #include <stdint.h>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -41,9 +42,12 @@ struct ServerOptions {
   // |                                              |
   // | skywalker thread model |          N          |
   // |                                              |
+  // | admin thread model     |     0 or 2          |
+  // |                                              |
   //  -----------------------------------------------
   // The saber' thread size is:
   // 7 + server_thread_size + paxos_io_thread_size + paxos_callback_thread_size
+  // + (admin_port != 0 ? 2 : 0)
 
   // Default: 3
   uint32_t server_thread_size;
@@ -63,6 +67,11 @@ struct ServerOptions {
   // Default: 4 * tick_time
   uint32_t session_timeout;
 
+  // The interval of cleaning up the expired TTL nodes and the empty
+  // containers in microseconds.
+  // Default: 1000 * 1000
+  uint32_t cleanup_interval;
+
   // Default: 60000
   uint32_t max_all_connections;
 
@@ -72,6 +81,21 @@ struct ServerOptions {
   // Default: 1024 * 1024
   uint32_t max_data_size;
 
+  // The high-water mark of the output buffer of each session in bytes.
+  // When it is crossed, the server stops reading the requests of the
+  // session and collapses its pending notifications into one ET_RESYNC
+  // event until the output buffer is drained.
+  // Default: 4 * 1024 * 1024
+  uint32_t max_output_buffer_size;
+
+  // The max number of the nodes under each root, 0 means no limit.
+  // Default: 0
+  uint64_t max_root_nodes;
+
+  // The max total data size of the nodes under each root, 0 means no limit.
+  // Default: 0
+  uint64_t max_root_bytes;
+
   // Default: 1000000
   uint32_t keep_log_count;
 
@@ -93,6 +117,41 @@ struct ServerOptions {
   // Default: ""
   std::string checkpoint_storage_path;
 
+  // The port of the admin server on the host of my_server_message, which
+  // answers the stats commands on its own threads, zero means disabled.
+  // Default: 0
+  uint16_t admin_port;
+
+  // Trace one of every trace_sample_interval requests which are not traced
+  // by the clients, zero means only the requests traced by the clients.
+  // Default: 0
+  uint32_t trace_sample_interval;
+
+  // The traced requests which take not less than it (in microseconds) from
+  // being received to being replied are kept for the admin server.
+  // Default: 100 * 1000
+  uint64_t slow_trace_threshold;
+
+  // How many slow traces to keep, the oldest ones are dropped.
+  // Default: 128
+  uint32_t slow_trace_count;
+
+  // The operations which take not less than the threshold (in microseconds)
+  // of their type are kept in the slow-op log for the admin server. The
+  // types are the names of the message types for the requests of the
+  // sessions, such as "MT_SETDATA", and "execute", "checkpoint" and
+  // "kill_sessions" for the calls of SaberDB. The types not in
+  // slow_op_thresholds use slow_op_threshold, zero means never logged.
+  // Default: 100 * 1000
+  uint64_t slow_op_threshold;
+
+  // Default: empty
+  std::map<std::string, uint64_t> slow_op_thresholds;
+
+  // How many slow ops to keep, the oldest ones are overwritten.
+  // Default: 256
+  uint32_t slow_op_count;
+
   ServerMessage my_server_message;
   std::vector<ServerMessage> all_server_messages;
 
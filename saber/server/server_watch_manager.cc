@@ -10,43 +10,48 @@
 
 namespace saber {
 
-ServerWatchManager::ServerWatchManager() {}
+ServerWatchManager::ServerWatchManager(uint32_t shard_size)
+    : shards_(shard_size > 0 ? shard_size : 1) {}
 
 ServerWatchManager::~ServerWatchManager() {}
 
 void ServerWatchManager::AddWatcher(const std::string& path, Watcher* watcher) {
-  MutexLock lock(&mutex_);
-  auto i = path_to_watches_.find(path);
-  if (i != path_to_watches_.end()) {
-    i->second->insert(watcher);
-  } else {
-    WatcherSetPtr watches(new WatcherSet());
-    watches->insert(watcher);
-    path_to_watches_.insert(std::make_pair(path, std::move(watches)));
-  }
-
-  auto j = watch_to_paths_.find(watcher);
-  if (j != watch_to_paths_.end()) {
-    j->second->insert(path);
-  } else {
-    PathSetPtr paths(new PathSet());
-    paths->insert(path);
-    watch_to_paths_.insert(std::make_pair(watcher, std::move(paths)));
+  Shard* shard = GetShard(path);
+  MutexLock lock(&shard->mutex);
+  uint32_t id = Intern(shard, path);
+  Entry& entry = shard->entries[id];
+  WatchList& list = shard->watchers[watcher];
+  if (!Contains(entry, list, watcher, id)) {
+    entry.watchers.push_back(
+        std::make_pair(watcher, static_cast<uint32_t>(list.size())));
+    list.push_back(
+        std::make_pair(id, static_cast<uint32_t>(entry.watchers.size() - 1)));
+    ++shard->watches;
   }
 }
 
 void ServerWatchManager::RemoveWatcher(Watcher* watcher) {
-  MutexLock lock(&mutex_);
-  auto i = watch_to_paths_.find(watcher);
-  if (i != watch_to_paths_.end()) {
-    for (auto& j : *(i->second)) {
-      auto k = path_to_watches_.find(j);
-      k->second->erase(watcher);
-      if (k->second->empty()) {
-        path_to_watches_.erase(j);
+  for (auto& shard : shards_) {
+    MutexLock lock(&shard.mutex);
+    auto i = shard.watchers.find(watcher);
+    if (i == shard.watchers.end()) {
+      continue;
+    }
+    for (auto& j : i->second) {
+      // Move the last watcher of the path to the removed position.
+      Entry& entry = shard.entries[j.first];
+      std::pair<Watcher*, uint32_t> last = entry.watchers.back();
+      entry.watchers[j.second] = last;
+      entry.watchers.pop_back();
+      if (last.first != watcher) {
+        shard.watchers[last.first][last.second].second = j.second;
+      }
+      if (entry.watchers.empty()) {
+        Release(&shard, j.first);
       }
     }
-    watch_to_paths_.erase(i);
+    shard.watches -= i->second.size();
+    shard.watchers.erase(i);
   }
 }
 
@@ -59,29 +64,103 @@ WatcherSetPtr ServerWatchManager::TriggerWatcher(const std::string& path,
                                                  EventType type,
                                                  WatcherSetPtr p) {
   WatcherSetPtr watches;
-  MutexLock lock(&mutex_);
-  auto i = path_to_watches_.find(path);
-  if (i != path_to_watches_.end()) {
+  Shard* shard = GetShard(path);
+  MutexLock lock(&shard->mutex);
+  auto i = shard->path_ids.find(path);
+  if (i != shard->path_ids.end()) {
+    uint32_t id = i->second;
+    std::vector<std::pair<Watcher*, uint32_t>> watchers;
+    watchers.swap(shard->entries[id].watchers);
+    Release(shard, id);
+    shard->watches -= watchers.size();
+
     WatchedEvent event;
     event.set_state(SS_CONNECTED);
     event.set_type(type);
     event.set_path(path);
 
-    for (auto& j : *(i->second)) {
-      auto k = watch_to_paths_.find(j);
-      k->second->erase(path);
-      if (k->second->empty()) {
-        watch_to_paths_.erase(k);
+    watches.reset(new WatcherSet());
+    for (auto& j : watchers) {
+      // Move the last path of the watcher to the removed position.
+      auto k = shard->watchers.find(j.first);
+      WatchList& list = k->second;
+      std::pair<uint32_t, uint32_t> last = list.back();
+      list[j.second] = last;
+      list.pop_back();
+      if (j.second < list.size()) {
+        shard->entries[last.first].watchers[last.second].second = j.second;
       }
-      if (p && p->find(j) != p->end()) {
+      if (list.empty()) {
+        shard->watchers.erase(k);
+      }
+      watches->insert(j.first);
+      if (p && p->find(j.first) != p->end()) {
         continue;
       }
-      j->Process(event);
+      j.first->Process(event);
     }
-    watches.swap(i->second);
-    path_to_watches_.erase(i);
   }
   return watches;
 }
 
+size_t ServerWatchManager::WatchCount() {
+  size_t count = 0;
+  for (auto& shard : shards_) {
+    MutexLock lock(&shard.mutex);
+    count += shard.watches;
+  }
+  return count;
+}
+
+ServerWatchManager::Shard* ServerWatchManager::GetShard(
+    const std::string& path) {
+  return &shards_[std::hash<std::string>()(path) % shards_.size()];
+}
+
+bool ServerWatchManager::Contains(const Entry& entry, const WatchList& list,
+                                  Watcher* watcher, uint32_t id) {
+  // Scan the shorter side, which is only long when both the path and the
+  // watcher have many watches.
+  if (list.size() <= entry.watchers.size()) {
+    for (auto& i : list) {
+      if (i.first == id) {
+        return true;
+      }
+    }
+  } else {
+    for (auto& i : entry.watchers) {
+      if (i.first == watcher) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+uint32_t ServerWatchManager::Intern(Shard* shard, const std::string& path) {
+  auto it = shard->path_ids.find(path);
+  if (it != shard->path_ids.end()) {
+    return it->second;
+  }
+  uint32_t id;
+  if (!shard->free_ids.empty()) {
+    id = shard->free_ids.back();
+    shard->free_ids.pop_back();
+  } else {
+    id = static_cast<uint32_t>(shard->entries.size());
+    shard->entries.push_back(Entry());
+  }
+  it = shard->path_ids.insert(std::make_pair(path, id)).first;
+  shard->entries[id].path = &it->first;
+  return id;
+}
+
+void ServerWatchManager::Release(Shard* shard, uint32_t id) {
+  Entry& entry = shard->entries[id];
+  shard->path_ids.erase(*entry.path);
+  entry.path = nullptr;
+  std::vector<std::pair<Watcher*, uint32_t>>().swap(entry.watchers);
+  shard->free_ids.push_back(id);
+}
+
 }  // namespace saber
@@ -5,9 +5,14 @@
 #ifndef SABER_SERVER_SERVER_WATCH_MANAGER_H_
 #define SABER_SERVER_SERVER_WATCH_MANAGER_H_
 
+#include <stdint.h>
+
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "saber/service/watcher.h"
 #include "saber/util/mutex.h"
@@ -16,7 +21,8 @@ namespace saber {
 
 class ServerWatchManager {
  public:
-  ServerWatchManager();
+  // The watches are sharded by path hash, each shard has its own lock.
+  explicit ServerWatchManager(uint32_t shard_size);
   ~ServerWatchManager();
 
   void AddWatcher(const std::string& path, Watcher* watcher);
@@ -26,10 +32,43 @@ class ServerWatchManager {
   WatcherSetPtr TriggerWatcher(const std::string& path, EventType type,
                                WatcherSetPtr p);
 
+  // The count of the (path, watcher) pairs, only for stats.
+  size_t WatchCount();
+
  private:
-  Mutex mutex_;
-  std::unordered_map<std::string, WatcherSetPtr> path_to_watches_;
-  std::unordered_map<Watcher*, PathSetPtr> watch_to_paths_;
+  // The watchers of an interned path.
+  struct Entry {
+    Entry() : path(nullptr) {}
+    // Points to the key in path_ids, nullptr if the id is free.
+    const std::string* path;
+    // Each watcher and the position of the path id in its WatchList.
+    std::vector<std::pair<Watcher*, uint32_t>> watchers;
+  };
+
+  // The path ids watched by a watcher, each with the position of the
+  // watcher in the entry of the path. Both sides are removed by moving the
+  // last element to the removed position and fixing its back position.
+  typedef std::vector<std::pair<uint32_t, uint32_t>> WatchList;
+
+  // The watches of the paths which are hashed to the shard.
+  struct Shard {
+    Shard() : watches(0) {}
+    Mutex mutex;
+    size_t watches;
+    std::unordered_map<std::string, uint32_t> path_ids;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> free_ids;
+    std::unordered_map<Watcher*, WatchList> watchers;
+  };
+
+  Shard* GetShard(const std::string& path);
+
+  static bool Contains(const Entry& entry, const WatchList& list,
+                       Watcher* watcher, uint32_t id);
+  static uint32_t Intern(Shard* shard, const std::string& path);
+  static void Release(Shard* shard, uint32_t id);
+
+  std::vector<Shard> shards_;
 
   // No copying allowed
   ServerWatchManager(const ServerWatchManager&);
@@ -0,0 +1,143 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "saber/server/slow_op_log.h"
+
+#include <string.h>
+
+#include <type_traits>
+
+#include "saber/util/logging.h"
+
+namespace saber {
+
+SlowOp::SlowOp()
+    : type(kRequest),
+      message_type(MT_PING),
+      group_id(0),
+      session_id(0),
+      instance_id(0),
+      time(0),
+      total_micros(0),
+      queue_micros(0),
+      doit_micros(0),
+      commit_micros(0),
+      send_micros(0),
+      lock_wait_micros(0),
+      request_bytes(0),
+      reply_bytes(0),
+      sessions(0) {
+  path[0] = '\0';
+}
+
+void SlowOp::set_path(const std::string& s) {
+  size_t size = s.size() < kMaxPathSize ? s.size() : kMaxPathSize;
+  memcpy(path, s.data(), size);
+  path[size] = '\0';
+}
+
+const char* SlowOp::TypeName() const {
+  switch (type) {
+    case kRequest:
+      return "request";
+    case kExecute:
+      return "execute";
+    case kCheckpoint:
+      return "checkpoint";
+    case kKillSessions:
+      return "kill_sessions";
+  }
+  return "unknown";
+}
+
+SlowOpLog::SlowOpLog(const ServerOptions& options)
+    : capacity_(options.slow_op_count),
+      slots_(new Slot[options.slow_op_count]),
+      tickets_(0),
+      dropped_(0) {
+  static_assert(std::is_trivially_copyable<SlowOp>::value,
+                "SlowOp is copied word by word");
+  for (int i = 0; i < MessageType_ARRAYSIZE; ++i) {
+    request_thresholds_[i] = options.slow_op_threshold;
+  }
+  for (auto& threshold : thresholds_) {
+    threshold = options.slow_op_threshold;
+  }
+  const char* kNames[] = {nullptr, "execute", "checkpoint", "kill_sessions"};
+  for (auto& it : options.slow_op_thresholds) {
+    MessageType message_type;
+    bool found = false;
+    if (MessageType_Parse(it.first, &message_type)) {
+      request_thresholds_[message_type] = it.second;
+      found = true;
+    }
+    for (int i = SlowOp::kExecute; i <= SlowOp::kKillSessions; ++i) {
+      if (it.first == kNames[i]) {
+        thresholds_[i] = it.second;
+        found = true;
+      }
+    }
+    if (!found) {
+      LOG_WARN("Unknown type of the slow op threshold: %s.",
+               it.first.c_str());
+    }
+  }
+  for (size_t i = 0; i < capacity_; ++i) {
+    slots_[i].seq.store(0, std::memory_order_relaxed);
+  }
+}
+
+SlowOpLog::~SlowOpLog() {}
+
+void SlowOpLog::Add(const SlowOp& op) {
+  if (capacity_ == 0) {
+    return;
+  }
+  uint64_t ticket = tickets_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[ticket % capacity_];
+  uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+  // Give up if the slot is being written, or a newer op has been written.
+  if ((seq & 1) != 0 || seq > 2 * ticket ||
+      !slot.seq.compare_exchange_strong(seq, 2 * ticket + 1,
+                                        std::memory_order_relaxed)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  uint64_t words[kWords] = {0};
+  memcpy(words, &op, sizeof(op));
+  for (size_t i = 0; i < kWords; ++i) {
+    slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot.seq.store(2 * ticket + 2, std::memory_order_release);
+}
+
+void SlowOpLog::GetOps(std::vector<SlowOp>* ops) const {
+  if (capacity_ == 0) {
+    return;
+  }
+  uint64_t end = tickets_.load(std::memory_order_acquire);
+  uint64_t begin = end > capacity_ ? end - capacity_ : 0;
+  uint64_t words[kWords];
+  for (uint64_t ticket = begin; ticket < end; ++ticket) {
+    const Slot& slot = slots_[ticket % capacity_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * ticket + 2) {
+      continue;
+    }
+    for (size_t i = 0; i < kWords; ++i) {
+      words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Skip the op which was overwritten while being copied.
+    if (slot.seq.load(std::memory_order_relaxed) != seq) {
+      continue;
+    }
+    SlowOp op;
+    memcpy(&op, words, sizeof(op));
+    ops->push_back(op);
+  }
+}
+
+}  // namespace saber
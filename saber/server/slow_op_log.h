@@ -0,0 +1,121 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_SERVER_SLOW_OP_LOG_H_
+#define SABER_SERVER_SLOW_OP_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "saber/proto/saber.pb.h"
+#include "saber/server/server_options.h"
+
+namespace saber {
+
+// An operation which took not less than the threshold of its type. It is
+// copied word by word into the log, so it must be trivially copyable.
+struct SlowOp {
+  enum Type {
+    // A request of SaberSession, from being received to being replied.
+    kRequest = 0,
+    kExecute = 1,
+    kCheckpoint = 2,
+    kKillSessions = 3,
+  };
+
+  static const size_t kMaxPathSize = 127;
+
+  SlowOp();
+
+  void set_path(const std::string& path);
+  const char* TypeName() const;
+
+  Type type;
+  // The type of the request or the applied value.
+  MessageType message_type;
+  uint32_t group_id;
+  uint64_t session_id;
+  uint64_t instance_id;
+  // The wall-clock time (in microseconds) when it finished.
+  uint64_t time;
+  uint64_t total_micros;
+  // The stages of the requests.
+  uint64_t queue_micros;
+  uint64_t doit_micros;
+  uint64_t commit_micros;
+  uint64_t send_micros;
+  // The time waited for the contended mutexes in the thread of the request
+  // or the call.
+  uint64_t lock_wait_micros;
+  // The bytes of the request and the reply, of the applied value, or of
+  // the checkpoint file.
+  uint64_t request_bytes;
+  uint64_t reply_bytes;
+  // The count of the sessions killed.
+  uint64_t sessions;
+  // The path truncated to kMaxPathSize bytes.
+  char path[kMaxPathSize + 1];
+};
+
+// The log of the latest slow operations of the server. Adding to it is
+// lock-free, and an op is dropped rather than waited for if its slot is
+// still being written by another thread. The callers should check IsSlow
+// or IsSlowRequest first, so that the fast operations cost only a
+// comparison.
+class SlowOpLog {
+ public:
+  explicit SlowOpLog(const ServerOptions& options);
+  ~SlowOpLog();
+
+  // For the requests of SaberSession, whose thresholds are of each type.
+  bool IsSlowRequest(MessageType message_type, uint64_t micros) const {
+    uint64_t threshold = MessageType_IsValid(message_type)
+                             ? request_thresholds_[message_type]
+                             : thresholds_[SlowOp::kRequest];
+    return threshold != 0 && micros >= threshold;
+  }
+
+  bool IsSlow(SlowOp::Type type, uint64_t micros) const {
+    uint64_t threshold = thresholds_[type];
+    return threshold != 0 && micros >= threshold;
+  }
+
+  void Add(const SlowOp& op);
+
+  // Get the ops in the log, the oldest first.
+  void GetOps(std::vector<SlowOp>* ops) const;
+
+  uint64_t DroppedCount() const { return dropped_.load(); }
+
+ private:
+  static const size_t kWords = (sizeof(SlowOp) + 7) / 8;
+
+  struct Slot {
+    // 2 * ticket + 1 while the op of the ticket is being written, and
+    // 2 * ticket + 2 after it was written.
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> words[kWords];
+  };
+
+  uint64_t request_thresholds_[MessageType_ARRAYSIZE];
+  uint64_t thresholds_[SlowOp::kKillSessions + 1];
+
+  const size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> tickets_;
+  std::atomic<uint64_t> dropped_;
+
+  // No copying allowed
+  SlowOpLog(const SlowOpLog&);
+  void operator=(const SlowOpLog&);
+};
+
+}  // namespace saber
+
+#endif  // SABER_SERVER_SLOW_OP_LOG_H_
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "saber/proto/saber.pb.h"
+#include "saber/proto/server.pb.h"
+#include "saber/server/data_tree.h"
+#include "saber/server/server_options.h"
+
+using namespace saber;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                 \
+      exit(1);                                                        \
+    }                                                                 \
+  } while (0)
+
+static Transaction NewTxn(uint64_t instance_id, uint64_t time) {
+  Transaction txn;
+  txn.set_instance_id(instance_id);
+  txn.set_time(time);
+  return txn;
+}
+
+static ResponseCode Create(DataTree* tree, const std::string& path,
+                           NodeType type, uint64_t ttl, uint64_t instance_id,
+                           bool only_check) {
+  CreateRequest request;
+  CreateResponse response;
+  request.set_path(path);
+  request.set_type(type);
+  request.set_ttl(ttl);
+  Transaction txn = NewTxn(instance_id, 0);
+  tree->Create(request, &txn, &response, only_check);
+  return response.code();
+}
+
+static bool Exists(DataTree* tree, const std::string& path) {
+  ExistsRequest request;
+  ExistsResponse response;
+  request.set_path(path);
+  tree->Exists(request, nullptr, &response);
+  return response.code() == RC_OK;
+}
+
+// The master checks the creates before proposing them, and a create which
+// is rejected or whose proposal fails must leave no trace, otherwise the
+// master would keep the nodes which the followers clean up.
+static void TestCleanupAfterFailedCreate() {
+  ServerOptions options;
+  // Each root holds one node, so any child create exceeds the quota.
+  options.max_root_nodes = 1;
+  DataTree tree(options);
+
+  CHECK(Create(&tree, "/t", NT_PERSISTENT_WITH_TTL, 1000, 1, false) ==
+        RC_OK);
+  CHECK(Create(&tree, "/t/x", NT_PERSISTENT, 0, 0, true) ==
+        RC_QUOTA_EXCEEDED);
+  std::vector<std::string> paths;
+  tree.GetExpiredNodes(5000, &paths);
+  CHECK(paths.size() == 1 && paths[0] == "/t");
+
+  // The container had a child, which was deleted, so it is empty now.
+  options.max_root_nodes = 0;
+  DataTree containers(options);
+  CHECK(Create(&containers, "/c", NT_CONTAINER, 0, 1, false) == RC_OK);
+  CHECK(Create(&containers, "/c/a", NT_PERSISTENT, 0, 2, false) == RC_OK);
+  DeleteRequest del;
+  DeleteResponse del_response;
+  del.set_path("/c/a");
+  del.set_version(-1);
+  Transaction txn = NewTxn(3, 0);
+  containers.Delete(del, &txn, &del_response);
+  CHECK(del_response.code() == RC_OK);
+  // The check passes but the proposal never commits.
+  CHECK(Create(&containers, "/c/b", NT_PERSISTENT, 0, 0, true) == RC_OK);
+
+  paths.clear();
+  containers.GetEmptyContainers(&paths);
+  CHECK(paths.size() == 1 && paths[0] == "/c");
+
+  CleanupRequest cleanup;
+  cleanup.add_path("/t");
+  txn = NewTxn(4, 5000);
+  tree.Cleanup(cleanup, &txn);
+  CHECK(!Exists(&tree, "/t"));
+
+  cleanup.set_path(0, "/c");
+  containers.Cleanup(cleanup, &txn);
+  CHECK(!Exists(&containers, "/c"));
+}
+
+static ResponseCode Increment(DataTree* tree, const std::string& data,
+                              int64_t* value) {
+  static uint64_t instance_id = 100;
+  std::string path = "/n" + std::to_string(instance_id);
+  CreateRequest create;
+  CreateResponse create_response;
+  create.set_path(path);
+  create.set_data(data);
+  create.set_type(NT_PERSISTENT);
+  Transaction txn = NewTxn(instance_id++, 0);
+  tree->Create(create, &txn, &create_response);
+  CHECK(create_response.code() == RC_OK);
+
+  IncrementRequest request;
+  IncrementResponse response;
+  request.set_path(path);
+  request.set_delta(1);
+  request.set_version(-1);
+  txn = NewTxn(instance_id++, 0);
+  tree->Increment(request, &txn, &response);
+  *value = response.value();
+  return response.code();
+}
+
+// Only the data which Increment would write back unchanged is a counter.
+static void TestIncrementCounterFormat() {
+  ServerOptions options;
+  DataTree tree(options);
+  int64_t value;
+  CHECK(Increment(&tree, "", &value) == RC_OK && value == 1);
+  CHECK(Increment(&tree, "0", &value) == RC_OK && value == 1);
+  CHECK(Increment(&tree, "-5", &value) == RC_OK && value == -4);
+  CHECK(Increment(&tree, "41", &value) == RC_OK && value == 42);
+  const char* bad[] = {"-", "-0", "00", "007", "-01", "+1", "1a", " 1"};
+  for (auto data : bad) {
+    CHECK(Increment(&tree, data, &value) == RC_BAD_ARGUMENTS);
+  }
+}
+
+int main() {
+  TestCleanupAfterFailedCreate();
+  TestIncrementCounterFormat();
+  printf("PASS\n");
+  return 0;
+}
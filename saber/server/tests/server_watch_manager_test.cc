@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "saber/server/server_watch_manager.h"
+
+using namespace saber;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                 \
+      exit(1);                                                        \
+    }                                                                 \
+  } while (0)
+
+class CountingWatcher : public Watcher {
+ public:
+  CountingWatcher() : events(0) {}
+  virtual void Process(const WatchedEvent& event) { ++events; }
+  int events;
+};
+
+// The watches are kept in a set of (path, watcher) pairs, which the
+// manager is compared with after each operation.
+static void TestRandomOperations() {
+  ServerWatchManager manager(4);
+  std::vector<CountingWatcher> watchers(16);
+  std::set<std::pair<std::string, Watcher*>> model;
+  std::mt19937 rng(301);
+
+  for (int n = 0; n < 200000; ++n) {
+    std::string path = "/" + std::to_string(rng() % 64);
+    Watcher* watcher = &watchers[rng() % watchers.size()];
+    uint32_t op = rng() % 16;
+    if (op < 11) {
+      manager.AddWatcher(path, watcher);
+      model.insert(std::make_pair(path, watcher));
+    } else if (op < 12) {
+      manager.RemoveWatcher(watcher);
+      for (auto it = model.begin(); it != model.end();) {
+        if (it->second == watcher) {
+          it = model.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    } else {
+      WatcherSet expected;
+      for (auto it = model.lower_bound(std::make_pair(path, nullptr));
+           it != model.end() && it->first == path;) {
+        expected.insert(it->second);
+        it = model.erase(it);
+      }
+      WatcherSetPtr p = manager.TriggerWatcher(path, ET_NODE_DELETED);
+      if (expected.empty()) {
+        CHECK(!p);
+      } else {
+        CHECK(p && *p == expected);
+      }
+    }
+    CHECK(manager.WatchCount() == model.size());
+  }
+}
+
+// The watchers in the suppressed set are removed without the event.
+static void TestSuppressed() {
+  ServerWatchManager manager(1);
+  CountingWatcher a, b;
+  manager.AddWatcher("/x", &a);
+  manager.AddWatcher("/x", &a);
+  manager.AddWatcher("/x", &b);
+  manager.AddWatcher("/y", &a);
+  CHECK(manager.WatchCount() == 3);
+
+  WatcherSetPtr suppressed(new WatcherSet());
+  suppressed->insert(&a);
+  WatcherSetPtr p =
+      manager.TriggerWatcher("/x", ET_NODE_DATA_CHANGED, std::move(suppressed));
+  CHECK(p && p->size() == 2);
+  CHECK(a.events == 0 && b.events == 1);
+  CHECK(manager.WatchCount() == 1);
+
+  p = manager.TriggerWatcher("/y", ET_NODE_DELETED);
+  CHECK(p && p->size() == 1 && a.events == 1);
+  CHECK(manager.WatchCount() == 0);
+}
+
+int main() {
+  TestRandomOperations();
+  TestSuppressed();
+  printf("PASS\n");
+  return 0;
+}
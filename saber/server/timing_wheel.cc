@@ -0,0 +1,69 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "saber/server/timing_wheel.h"
+
+#include <assert.h>
+
+#include <utility>
+
+namespace saber {
+
+TimingWheel::TimingWheel(uint64_t tick, size_t slot_size)
+    : kTick(tick > 0 ? tick : 1), current_(0), slots_(slot_size) {
+  assert(slot_size > 0);
+}
+
+TimingWheel::~TimingWheel() {}
+
+void TimingWheel::Add(const std::string& key, uint64_t deadline) {
+  Remove(key);
+  uint64_t ticks = deadline / kTick;
+  // The slot of a past deadline may have been passed by the cursor.
+  if (ticks < current_) {
+    ticks = current_;
+  }
+  Entry entry;
+  entry.deadline = deadline;
+  entry.slot = Slot(ticks);
+  slots_[entry.slot].insert(key);
+  entries_.insert(std::make_pair(key, entry));
+}
+
+void TimingWheel::Remove(const std::string& key) {
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    slots_[it->second.slot].erase(key);
+    entries_.erase(it);
+  }
+}
+
+void TimingWheel::Expire(uint64_t now, std::vector<std::string>* keys) {
+  uint64_t target = now / kTick;
+  if (target < current_) {
+    return;
+  }
+  uint64_t count = target - current_ + 1;
+  if (current_ == 0 || count > slots_.size()) {
+    count = slots_.size();
+  }
+  for (uint64_t i = 0; i < count; ++i) {
+    std::unordered_set<std::string>& slot = slots_[Slot(target - i)];
+    for (auto it = slot.begin(); it != slot.end();) {
+      auto e = entries_.find(*it);
+      assert(e != entries_.end());
+      if (e->second.deadline <= now) {
+        keys->push_back(*it);
+        entries_.erase(e);
+        it = slot.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  // The slot of target may get new keys later, so it will be visited again.
+  current_ = target;
+}
+
+}  // namespace saber
@@ -0,0 +1,58 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_SERVER_TIMING_WHEEL_H_
+#define SABER_SERVER_TIMING_WHEEL_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace saber {
+
+// A hashed timing wheel of the deadlines of the keys. The deadlines which
+// are beyond one round of the wheel stay in their slot until the cursor
+// comes around again.
+// No thread safe
+class TimingWheel {
+ public:
+  // The tick is in the same unit as the deadlines.
+  TimingWheel(uint64_t tick, size_t slot_size);
+  ~TimingWheel();
+
+  // Add the key, or reschedule it if the key has been added.
+  void Add(const std::string& key, uint64_t deadline);
+
+  void Remove(const std::string& key);
+
+  // Take out all the keys whose deadline is not later than now.
+  void Expire(uint64_t now, std::vector<std::string>* keys);
+
+  size_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    uint64_t deadline;
+    size_t slot;
+  };
+
+  size_t Slot(uint64_t ticks) const { return ticks % slots_.size(); }
+
+  const uint64_t kTick;
+
+  uint64_t current_;
+  std::vector<std::unordered_set<std::string>> slots_;
+  std::unordered_map<std::string, Entry> entries_;
+
+  // No copying allowed
+  TimingWheel(const TimingWheel&);
+  void operator=(const TimingWheel&);
+};
+
+}  // namespace saber
+
+#endif  // SABER_SERVER_TIMING_WHEEL_H_
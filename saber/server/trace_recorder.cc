@@ -0,0 +1,39 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "saber/server/trace_recorder.h"
+
+#include "saber/util/mutexlock.h"
+
+namespace saber {
+
+TraceRecorder::TraceRecorder(uint64_t threshold, size_t capacity)
+    : threshold_(threshold), ring_(capacity), count_(0) {}
+
+TraceRecorder::~TraceRecorder() {}
+
+void TraceRecorder::Add(uint32_t group_id, uint64_t session_id,
+                        MessageType type, const Trace& trace) {
+  if (ring_.empty() || trace.received_micros() == 0 ||
+      trace.sent_micros() < trace.received_micros() + threshold_) {
+    return;
+  }
+  MutexLock lock(&mutex_);
+  TraceRecord& record = ring_[count_ % ring_.size()];
+  record.group_id = group_id;
+  record.session_id = session_id;
+  record.type = type;
+  record.trace = trace;
+  ++count_;
+}
+
+void TraceRecorder::GetTraces(std::vector<TraceRecord>* traces) const {
+  MutexLock lock(&mutex_);
+  uint64_t first = count_ > ring_.size() ? count_ - ring_.size() : 0;
+  for (uint64_t i = first; i < count_; ++i) {
+    traces->push_back(ring_[i % ring_.size()]);
+  }
+}
+
+}  // namespace saber
@@ -0,0 +1,56 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_SERVER_TRACE_RECORDER_H_
+#define SABER_SERVER_TRACE_RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "saber/proto/saber.pb.h"
+#include "saber/util/mutex.h"
+
+namespace saber {
+
+// Keeps the latest slow traces in a ring buffer, so that they can be dumped
+// by the admin server.
+class TraceRecorder {
+ public:
+  struct TraceRecord {
+    TraceRecord() : group_id(0), session_id(0), type(MT_PING) {}
+    uint32_t group_id;
+    uint64_t session_id;
+    MessageType type;
+    Trace trace;
+  };
+
+  // The traces which take not less than threshold microseconds from being
+  // received to being sent are kept, at most capacity of them.
+  TraceRecorder(uint64_t threshold, size_t capacity);
+  ~TraceRecorder();
+
+  void Add(uint32_t group_id, uint64_t session_id, MessageType type,
+           const Trace& trace);
+
+  // Get the kept traces, the oldest first.
+  void GetTraces(std::vector<TraceRecord>* traces) const;
+
+ private:
+  const uint64_t threshold_;
+
+  mutable Mutex mutex_;
+  std::vector<TraceRecord> ring_;
+  // The count of the traces ever kept.
+  uint64_t count_;
+
+  // No copying allowed
+  TraceRecorder(const TraceRecorder&);
+  void operator=(const TraceRecorder&);
+};
+
+}  // namespace saber
+
+#endif  // SABER_SERVER_TRACE_RECORDER_H_
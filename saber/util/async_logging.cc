@@ -0,0 +1,442 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "saber/util/async_logging.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "saber/util/mutexlock.h"
+
+namespace saber {
+
+AsyncLoggingOptions::AsyncLoggingOptions()
+    : max_file_size(64 * 1024 * 1024),
+      max_files(10),
+      buffer_size(256 * 1024),
+      flush_interval(10 * 1000),
+      rate_limit(100) {}
+
+// The single-producer single-consumer ring of the formatted logs, which
+// is written by its own thread and read by the writer thread.
+class AsyncLogging::Buffer {
+ public:
+  explicit Buffer(size_t size)
+      : data_(new char[size]),
+        size_(size),
+        head_(0),
+        tail_(0),
+        closed_(false),
+        cached_seconds_(-1) {}
+
+  ~Buffer() { delete[] data_; }
+
+  // Return false if there is not enough space, only called by its thread.
+  bool Push(const char* data, size_t size) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail + size > size_) {
+      return false;
+    }
+    size_t offset = static_cast<size_t>(head & (size_ - 1));
+    size_t n = std::min(size, size_ - offset);
+    memcpy(data_ + offset, data, n);
+    memcpy(data_, data + n, size - n);
+    head_.store(head + size, std::memory_order_release);
+    return true;
+  }
+
+  // Only called by the writer thread.
+  void PopAll(std::string* output) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    size_t size = static_cast<size_t>(head - tail);
+    size_t offset = static_cast<size_t>(tail & (size_ - 1));
+    size_t n = std::min(size, size_ - offset);
+    output->append(data_ + offset, n);
+    output->append(data_, size - n);
+    tail_.store(head, std::memory_order_release);
+  }
+
+  bool HalfFull() const {
+    return head_.load(std::memory_order_relaxed) -
+               tail_.load(std::memory_order_relaxed) >
+           size_ / 2;
+  }
+
+  // Set when its thread exits, then it is deleted by the writer thread.
+  void Close() { closed_.store(true); }
+  bool Closed() const { return closed_.load(); }
+
+  // Format the time as "[2017/01/01-00:00:00.000000]" and return the size.
+  // The date is only formatted once per second.
+  size_t FormatTime(const struct timeval& tv, char* p) {
+    if (tv.tv_sec != cached_seconds_) {
+      cached_seconds_ = tv.tv_sec;
+      struct tm t;
+      localtime_r(&cached_seconds_, &t);
+      snprintf(cached_time_, sizeof(cached_time_),
+               "[%04d/%02d/%02d-%02d:%02d:%02d.", t.tm_year + 1900,
+               t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    }
+    memcpy(p, cached_time_, kDateSize);
+    int micros = static_cast<int>(tv.tv_usec);
+    for (size_t i = kDateSize + 5; i >= kDateSize; --i) {
+      p[i] = static_cast<char>('0' + micros % 10);
+      micros /= 10;
+    }
+    p[kDateSize + 6] = ']';
+    return kDateSize + 7;
+  }
+
+ private:
+  static const size_t kDateSize = 21;
+
+  char* const data_;
+  const size_t size_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> tail_;
+  std::atomic<bool> closed_;
+
+  time_t cached_seconds_;
+  // Large enough for the fields of any struct tm, even if only the first
+  // kDateSize bytes are used.
+  char cached_time_[80];
+
+  // No copying allowed
+  Buffer(const Buffer&);
+  void operator=(const Buffer&);
+};
+
+static std::atomic<AsyncLogging*> g_async_logging(nullptr);
+// The count of the calls of Handler in progress, Stop waits for them to
+// finish before the last drain.
+static std::atomic<int> g_appending(0);
+
+AsyncLogging::AsyncLogging(const AsyncLoggingOptions& options)
+    : options_(options),
+      old_handler_(nullptr),
+      running_(false),
+      cond_(&mutex_),
+      flushed_cond_(&mutex_),
+      flush_requests_(0),
+      flushed_requests_(0),
+      writer_tid_(0),
+      dropped_(0),
+      fd_(STDERR_FILENO),
+      file_size_(0) {
+  for (size_t i = 0; i < kSiteSize; ++i) {
+    sites_[i].window.store(0);
+    sites_[i].suppressed.store(0);
+  }
+  pthread_key_create(&key_, &AsyncLogging::DeleteBuffer);
+}
+
+AsyncLogging::~AsyncLogging() {
+  Stop();
+  for (auto& buffer : buffers_) {
+    delete buffer;
+  }
+  pthread_key_delete(key_);
+}
+
+bool AsyncLogging::Start() {
+  assert(!running_);
+  if (!options_.path.empty()) {
+    OpenFile();
+    if (fd_ < 0) {
+      return false;
+    }
+  }
+  running_ = true;
+  thread_.Start(&AsyncLogging::StartWriter, this);
+  g_async_logging.store(this);
+  old_handler_ = SetLogHandler(&AsyncLogging::Handler);
+  return true;
+}
+
+void AsyncLogging::Stop() {
+  if (!running_) {
+    return;
+  }
+  SetLogHandler(old_handler_);
+  g_async_logging.store(nullptr);
+  while (g_appending.load() != 0) {
+    sched_yield();
+  }
+  {
+    MutexLock lock(&mutex_);
+    running_ = false;
+    cond_.Signal();
+  }
+  thread_.Join();
+}
+
+void AsyncLogging::Flush() {
+  MutexLock lock(&mutex_);
+  if (!running_) {
+    return;
+  }
+  uint64_t request = ++flush_requests_;
+  cond_.Signal();
+  while (flushed_requests_ < request) {
+    flushed_cond_.Wait();
+  }
+}
+
+void AsyncLogging::Handler(LogLevel level, const char* filename, int line,
+                           const char* format, va_list ap) {
+  g_appending.fetch_add(1);
+  AsyncLogging* logging = g_async_logging.load();
+  if (logging != nullptr) {
+    logging->Append(level, filename, line, format, ap);
+  } else {
+    DefaultLogHandler(level, filename, line, format, ap);
+  }
+  g_appending.fetch_sub(1);
+}
+
+void* AsyncLogging::StartWriter(void* data) {
+  AsyncLogging* logging = reinterpret_cast<AsyncLogging*>(data);
+  logging->WriterLoop();
+  return nullptr;
+}
+
+void AsyncLogging::DeleteBuffer(void* data) {
+  reinterpret_cast<Buffer*>(data)->Close();
+}
+
+void AsyncLogging::Append(LogLevel level, const char* filename, int line,
+                          const char* format, va_list ap) {
+  static const char* kLoglevelNames[] = {"DEBUG", "INFO", "WARN", "ERROR",
+                                         "FATAL"};
+  // The room for the count of the suppressed logs and the newline.
+  static const int kTailSize = 64;
+
+  struct timeval now_tv;
+  gettimeofday(&now_tv, nullptr);
+
+  uint32_t suppressed = 0;
+  if (level != LOGLEVEL_FATAL &&
+      !Allow(filename, line, static_cast<uint64_t>(now_tv.tv_sec),
+             &suppressed)) {
+    return;
+  }
+
+  Buffer* buffer = GetBuffer();
+  char stack[512];
+  char* base = stack;
+  char* p = stack;
+  for (int i = 0; i < 2; ++i) {
+    int bufsize;
+    if (i == 0) {
+      bufsize = static_cast<int>(sizeof(stack));
+    } else {
+      bufsize = 30000;
+      base = new char[bufsize];
+    }
+    p = base;
+    char* limit = base + bufsize - kTailSize;
+
+    p += buffer->FormatTime(now_tv, p);
+    p += snprintf(p, static_cast<size_t>(limit - p), "[%s %s:%d] ",
+                  kLoglevelNames[level], filename, line);
+    if (p < limit) {
+      va_list backup_ap;
+      va_copy(backup_ap, ap);
+      p += vsnprintf(p, static_cast<size_t>(limit - p), format, backup_ap);
+      va_end(backup_ap);
+    }
+    if (p >= limit) {
+      if (i == 0) {
+        continue;
+      }
+      p = limit - 1;
+    }
+    break;
+  }
+  if (suppressed > 0) {
+    p += snprintf(p, kTailSize, " (%u similar logs suppressed)", suppressed);
+  }
+  *p++ = '\n';
+
+  size_t size = static_cast<size_t>(p - base);
+  if (!buffer->Push(base, size)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (buffer->HalfFull()) {
+    // It may be missed without the mutex, but the writer thread also wakes
+    // up every flush_interval.
+    cond_.Signal();
+  }
+
+  if (level == LOGLEVEL_FATAL) {
+    if (writer_tid_.load() == CurrentThread::Tid()) {
+      ssize_t res = write(STDERR_FILENO, base, size);
+      (void)res;
+    } else {
+      Flush();
+    }
+  }
+  if (base != stack) {
+    delete[] base;
+  }
+  if (level == LOGLEVEL_FATAL) {
+    abort();
+  }
+}
+
+AsyncLogging::Buffer* AsyncLogging::GetBuffer() {
+  Buffer* buffer = reinterpret_cast<Buffer*>(pthread_getspecific(key_));
+  if (buffer == nullptr) {
+    buffer = new Buffer(options_.buffer_size);
+    {
+      MutexLock lock(&mutex_);
+      buffers_.push_back(buffer);
+    }
+    pthread_setspecific(key_, buffer);
+  }
+  return buffer;
+}
+
+bool AsyncLogging::Allow(const char* filename, int line, uint64_t seconds,
+                         uint32_t* suppressed) {
+  if (options_.rate_limit == 0) {
+    return true;
+  }
+  // The key is not compared, the lines which share the same site also
+  // share the limit, which is cheaper and harmless as it is rare.
+  size_t index = (reinterpret_cast<uintptr_t>(filename) +
+                  static_cast<size_t>(line) * 31) %
+                 kSiteSize;
+  Site& site = sites_[index];
+  seconds &= 0xffffffff;
+  uint64_t window = site.window.load(std::memory_order_relaxed);
+  while (true) {
+    if ((window >> 32) != seconds) {
+      if (site.window.compare_exchange_weak(window, (seconds << 32) | 1)) {
+        *suppressed = site.suppressed.exchange(0);
+        return true;
+      }
+    } else if ((window & 0xffffffff) < options_.rate_limit) {
+      if (site.window.compare_exchange_weak(window, window + 1)) {
+        return true;
+      }
+    } else {
+      site.suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+}
+
+void AsyncLogging::WriterLoop() {
+  writer_tid_.store(CurrentThread::Tid());
+  bool running = true;
+  while (running) {
+    uint64_t requests;
+    {
+      MutexLock lock(&mutex_);
+      if (running_ && flush_requests_ == flushed_requests_) {
+        cond_.Wait(options_.flush_interval);
+      }
+      requests = flush_requests_;
+      running = running_;
+      for (auto it = buffers_.begin(); it != buffers_.end();) {
+        // Check it first, so that the last logs of the buffer are popped.
+        bool closed = (*it)->Closed();
+        (*it)->PopAll(&output_);
+        if (closed) {
+          delete *it;
+          it = buffers_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    Write(output_.data(), output_.size());
+    output_.clear();
+
+    {
+      MutexLock lock(&mutex_);
+      flushed_requests_ = requests;
+      flushed_cond_.SignalAll();
+    }
+  }
+  if (fd_ != STDERR_FILENO) {
+    close(fd_);
+    fd_ = STDERR_FILENO;
+  }
+}
+
+void AsyncLogging::Write(const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd_, data, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "write log failed: %s\n", strerror(errno));
+      return;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+    file_size_ += static_cast<size_t>(n);
+  }
+  if (fd_ != STDERR_FILENO && file_size_ >= options_.max_file_size) {
+    RotateFile();
+  }
+}
+
+void AsyncLogging::OpenFile() {
+  fd_ = open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd_ < 0) {
+    fprintf(stderr, "open %s failed: %s\n", options_.path.c_str(),
+            strerror(errno));
+    return;
+  }
+  off_t size = lseek(fd_, 0, SEEK_END);
+  file_size_ = size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+void AsyncLogging::RotateFile() {
+  close(fd_);
+
+  time_t seconds = time(nullptr);
+  struct tm t;
+  localtime_r(&seconds, &t);
+  // Large enough for the fields of any struct tm.
+  char suffix[80];
+  snprintf(suffix, sizeof(suffix), ".%04d%02d%02d-%02d%02d%02d",
+           t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min,
+           t.tm_sec);
+  std::string name = options_.path + suffix;
+  for (int i = 1; access(name.c_str(), F_OK) == 0; ++i) {
+    name = options_.path + suffix + "." + std::to_string(i);
+  }
+  if (rename(options_.path.c_str(), name.c_str()) == 0) {
+    old_files_.push_back(name);
+    while (options_.max_files > 0 && old_files_.size() > options_.max_files) {
+      unlink(old_files_.front().c_str());
+      old_files_.pop_front();
+    }
+  }
+
+  OpenFile();
+  if (fd_ < 0) {
+    fd_ = STDERR_FILENO;
+  }
+}
+
+}  // namespace saber
@@ -0,0 +1,141 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_UTIL_ASYNC_LOGGING_H_
+#define SABER_UTIL_ASYNC_LOGGING_H_
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "saber/util/logging.h"
+#include "saber/util/mutex.h"
+#include "saber/util/thread.h"
+
+namespace saber {
+
+struct AsyncLoggingOptions {
+  // The log file, the logs are written to stderr if it is empty.
+  // Default: ""
+  std::string path;
+
+  // The log file is renamed with the time as the suffix and a new one is
+  // created when its size exceeds it.
+  // Default: 64 * 1024 * 1024
+  size_t max_file_size;
+
+  // How many renamed log files to keep, zero means to keep all of them.
+  // Default: 10
+  size_t max_files;
+
+  // The size of the buffer of each logging thread, which must be a power
+  // of two. The logs are dropped when the buffer is full.
+  // Default: 256 * 1024
+  size_t buffer_size;
+
+  // How often the writer thread drains the buffers in microseconds.
+  // Default: 10 * 1000
+  uint64_t flush_interval;
+
+  // The most logs per second from the same source line, zero means no
+  // limit. The count of the suppressed logs is appended to the first log
+  // of the line in the next second. The lines are hashed into 1024 sites
+  // by the address of the file name and the line number, so two lines in
+  // rare cases share the same site and the same limit.
+  // Default: 100
+  uint32_t rate_limit;
+
+  AsyncLoggingOptions();
+};
+
+// The log handler which never blocks the caller on disk. Each thread
+// formats its logs into its own lock-free buffer, and a writer thread
+// drains all the buffers to the log file. Only one instance can be
+// started at the same time.
+class AsyncLogging {
+ public:
+  explicit AsyncLogging(const AsyncLoggingOptions& options);
+  ~AsyncLogging();
+
+  // Install it as the log handler of saber::Log.
+  bool Start();
+  // Restore the previous log handler, wait for the logs being appended and
+  // write all the buffered logs.
+  void Stop();
+
+  // Wait for the writer thread to write the logs buffered before the call.
+  void Flush();
+
+  // The count of the logs dropped as the buffers were full.
+  uint64_t DroppedCount() const { return dropped_.load(); }
+
+ private:
+  class Buffer;
+
+  struct Site {
+    // The second in the high 32 bits and the count in the low 32 bits.
+    std::atomic<uint64_t> window;
+    std::atomic<uint32_t> suppressed;
+  };
+
+  static const size_t kSiteSize = 1024;
+
+  static void Handler(LogLevel level, const char* filename, int line,
+                      const char* format, va_list ap);
+  static void* StartWriter(void* data);
+  static void DeleteBuffer(void* data);
+
+  void Append(LogLevel level, const char* filename, int line,
+              const char* format, va_list ap);
+  Buffer* GetBuffer();
+  // Return false if the log should be dropped, otherwise the count of the
+  // logs suppressed before is set.
+  bool Allow(const char* filename, int line, uint64_t seconds,
+             uint32_t* suppressed);
+
+  void WriterLoop();
+  // Return the bytes written.
+  size_t Drain();
+  void Write(const char* data, size_t size);
+  void OpenFile();
+  void RotateFile();
+
+  const AsyncLoggingOptions options_;
+
+  pthread_key_t key_;
+  LogHandler* old_handler_;
+  Thread thread_;
+  bool running_;
+
+  Mutex mutex_;
+  Condition cond_;
+  Condition flushed_cond_;
+  std::vector<Buffer*> buffers_;
+  uint64_t flush_requests_;
+  uint64_t flushed_requests_;
+
+  std::atomic<uint64_t> writer_tid_;
+  std::atomic<uint64_t> dropped_;
+  Site sites_[kSiteSize];
+
+  // Only used in the writer thread.
+  int fd_;
+  size_t file_size_;
+  std::deque<std::string> old_files_;
+  std::string output_;
+
+  // No copying allowed
+  AsyncLogging(const AsyncLogging&);
+  void operator=(const AsyncLogging&);
+};
+
+}  // namespace saber
+
+#endif  // SABER_UTIL_ASYNC_LOGGING_H_
@@ -0,0 +1,206 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "saber/util/metrics.h"
+
+#include <stdio.h>
+
+#include "saber/util/mutexlock.h"
+#include "saber/util/thread.h"
+
+namespace saber {
+
+Counter::Counter() {
+  for (size_t i = 0; i < kShards; ++i) {
+    cells_[i].value.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Counter::Add(int64_t n) {
+  cells_[CurrentThread::Tid() % kShards].value.fetch_add(
+      n, std::memory_order_relaxed);
+}
+
+int64_t Counter::Value() const {
+  int64_t value = 0;
+  for (size_t i = 0; i < kShards; ++i) {
+    value += cells_[i].value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+Histogram::Histogram() : shards_(new Shard[kShards]) {
+  for (size_t i = 0; i < kShards; ++i) {
+    Shard& shard = shards_[i];
+    shard.count.store(0, std::memory_order_relaxed);
+    shard.sum.store(0, std::memory_order_relaxed);
+    shard.max.store(0, std::memory_order_relaxed);
+    for (size_t j = 0; j < kBuckets; ++j) {
+      shard.buckets[j].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Histogram::Record(uint64_t value) {
+  Shard& shard = shards_[CurrentThread::Tid() % kShards];
+  shard.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = shard.max.load(std::memory_order_relaxed);
+  while (value > max &&
+         !shard.max.compare_exchange_weak(max, value,
+                                          std::memory_order_relaxed)) {
+  }
+}
+
+void Histogram::GetSnapshot(HistogramSnapshot* snapshot) const {
+  uint64_t buckets[kBuckets] = {0};
+  *snapshot = HistogramSnapshot();
+  for (size_t i = 0; i < kShards; ++i) {
+    const Shard& shard = shards_[i];
+    for (size_t j = 0; j < kBuckets; ++j) {
+      buckets[j] += shard.buckets[j].load(std::memory_order_relaxed);
+    }
+    snapshot->sum += shard.sum.load(std::memory_order_relaxed);
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    if (max > snapshot->max) {
+      snapshot->max = max;
+    }
+  }
+  // Count the buckets instead of reading the counts of the shards, so that
+  // the percentiles are consistent with the count.
+  for (size_t j = 0; j < kBuckets; ++j) {
+    snapshot->count += buckets[j];
+  }
+  if (snapshot->count == 0) {
+    return;
+  }
+
+  const double kPercentiles[] = {0.5, 0.9, 0.99, 0.999};
+  uint64_t* results[] = {&snapshot->p50, &snapshot->p90, &snapshot->p99,
+                         &snapshot->p999};
+  size_t k = 0;
+  uint64_t seen = 0;
+  for (size_t j = 0; j < kBuckets && k < 4; ++j) {
+    seen += buckets[j];
+    while (k < 4 &&
+           static_cast<double>(seen) >=
+               kPercentiles[k] * static_cast<double>(snapshot->count)) {
+      uint64_t limit = BucketLimit(j);
+      *results[k] = limit < snapshot->max ? limit : snapshot->max;
+      ++k;
+    }
+  }
+}
+
+size_t Histogram::BucketIndex(uint64_t value) {
+  if (value < 2 * kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+  int bits = 64 - __builtin_clzll(value);
+  if (bits > kMaxBits) {
+    return kBuckets - 1;
+  }
+  int shift = bits - kSubBits - 1;
+  size_t sub = static_cast<size_t>(value >> shift) & (kSubBuckets - 1);
+  return static_cast<size_t>(shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t Histogram::BucketLimit(size_t index) {
+  if (index < 2 * kSubBuckets) {
+    return index;
+  }
+  int shift = static_cast<int>(index / kSubBuckets) - 1;
+  uint64_t sub = index % kSubBuckets;
+  return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+std::string MetricsSnapshot::ToString() const {
+  std::string s;
+  char buf[256];
+  for (auto& it : counters) {
+    snprintf(buf, sizeof(buf), " %lld\n", static_cast<long long>(it.second));
+    s += it.first;
+    s += buf;
+  }
+  for (auto& it : histograms) {
+    const HistogramSnapshot& h = it.second;
+    snprintf(buf, sizeof(buf),
+             " count=%llu mean=%.1f p50=%llu p90=%llu p99=%llu p999=%llu "
+             "max=%llu\n",
+             static_cast<unsigned long long>(h.count), h.Mean(),
+             static_cast<unsigned long long>(h.p50),
+             static_cast<unsigned long long>(h.p90),
+             static_cast<unsigned long long>(h.p99),
+             static_cast<unsigned long long>(h.p999),
+             static_cast<unsigned long long>(h.max));
+    s += it.first;
+    s += buf;
+  }
+  return s;
+}
+
+std::string MetricsSnapshot::ToJson() const {
+  // The names of the metrics are plain identifiers, so they are not escaped.
+  std::string s = "{\"counters\":{";
+  char buf[256];
+  bool first = true;
+  for (auto& it : counters) {
+    snprintf(buf, sizeof(buf), "\":%lld", static_cast<long long>(it.second));
+    s += first ? "\"" : ",\"";
+    s += it.first;
+    s += buf;
+    first = false;
+  }
+  s += "},\"histograms\":{";
+  first = true;
+  for (auto& it : histograms) {
+    const HistogramSnapshot& h = it.second;
+    snprintf(buf, sizeof(buf),
+             "\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,"
+             "\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+             static_cast<unsigned long long>(h.count), h.Mean(),
+             static_cast<unsigned long long>(h.p50),
+             static_cast<unsigned long long>(h.p90),
+             static_cast<unsigned long long>(h.p99),
+             static_cast<unsigned long long>(h.p999),
+             static_cast<unsigned long long>(h.max));
+    s += first ? "\"" : ",\"";
+    s += it.first;
+    s += buf;
+    first = false;
+  }
+  s += "}}";
+  return s;
+}
+
+Counter* MetricsRegistry::GetCounter(const std::string& name) {
+  MutexLock lock(&mutex_);
+  std::unique_ptr<Counter>& counter = counters_[name];
+  if (!counter) {
+    counter.reset(new Counter());
+  }
+  return counter.get();
+}
+
+Histogram* MetricsRegistry::GetHistogram(const std::string& name) {
+  MutexLock lock(&mutex_);
+  std::unique_ptr<Histogram>& histogram = histograms_[name];
+  if (!histogram) {
+    histogram.reset(new Histogram());
+  }
+  return histogram.get();
+}
+
+void MetricsRegistry::GetSnapshot(MetricsSnapshot* snapshot) const {
+  MutexLock lock(&mutex_);
+  for (auto& it : counters_) {
+    snapshot->counters[it.first] = it.second->Value();
+  }
+  for (auto& it : histograms_) {
+    it.second->GetSnapshot(&snapshot->histograms[it.first]);
+  }
+}
+
+}  // namespace saber
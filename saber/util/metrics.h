@@ -0,0 +1,137 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_UTIL_METRICS_H_
+#define SABER_UTIL_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "saber/util/mutex.h"
+
+namespace saber {
+
+// A counter which is sharded by thread, so that the threads adding to it
+// don't contend on the same cache line.
+class Counter {
+ public:
+  Counter();
+
+  void Add(int64_t n);
+  void Increment() { Add(1); }
+
+  int64_t Value() const;
+
+ private:
+  static const size_t kShards = 16;
+
+  struct Cell {
+    std::atomic<int64_t> value;
+    char padding[64 - sizeof(std::atomic<int64_t>)];
+  };
+
+  Cell cells_[kShards];
+
+  // No copying allowed
+  Counter(const Counter&);
+  void operator=(const Counter&);
+};
+
+struct HistogramSnapshot {
+  HistogramSnapshot() : count(0), sum(0), max(0), p50(0), p90(0), p99(0),
+                        p999(0) {}
+
+  double Mean() const {
+    return count > 0 ? static_cast<double>(sum) / static_cast<double>(count)
+                     : 0.0;
+  }
+
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t p999;
+};
+
+// A log-linear histogram like HdrHistogram. Each power of two is split into
+// kSubBuckets buckets, so the relative error of the percentiles is less
+// than 1/kSubBuckets. The values not less than 2^kMaxBits are recorded in
+// the last bucket.
+class Histogram {
+ public:
+  Histogram();
+
+  void Record(uint64_t value);
+
+  void GetSnapshot(HistogramSnapshot* snapshot) const;
+
+  static size_t BucketIndex(uint64_t value);
+  // The largest value of the bucket.
+  static uint64_t BucketLimit(size_t index);
+
+ private:
+  static const int kSubBits = 4;
+  static const int kMaxBits = 36;
+  static const size_t kSubBuckets = 1 << kSubBits;
+  static const size_t kBuckets = (kMaxBits - kSubBits + 1) * kSubBuckets;
+  static const size_t kShards = 4;
+
+  struct Shard {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[kBuckets];
+  };
+
+  std::unique_ptr<Shard[]> shards_;
+
+  // No copying allowed
+  Histogram(const Histogram&);
+  void operator=(const Histogram&);
+};
+
+struct MetricsSnapshot {
+  // The counters and the gauges.
+  std::map<std::string, int64_t> counters;
+  std::map<std::string, HistogramSnapshot> histograms;
+
+  // One metric per line, as "name value" or "name count=.. mean=.. ...".
+  std::string ToString() const;
+  // As {"counters":{"name":value,...},"histograms":{"name":{...},...}}.
+  std::string ToJson() const;
+};
+
+// The metrics are created on the first use and live as long as the
+// registry, so the callers should keep the pointers instead of looking
+// them up on the hot path.
+class MetricsRegistry {
+ public:
+  MetricsRegistry() {}
+  ~MetricsRegistry() {}
+
+  Counter* GetCounter(const std::string& name);
+  Histogram* GetHistogram(const std::string& name);
+
+  void GetSnapshot(MetricsSnapshot* snapshot) const;
+
+ private:
+  mutable Mutex mutex_;
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+
+  // No copying allowed
+  MetricsRegistry(const MetricsRegistry&);
+  void operator=(const MetricsRegistry&);
+};
+
+}  // namespace saber
+
+#endif  // SABER_UTIL_METRICS_H_
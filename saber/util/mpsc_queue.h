@@ -0,0 +1,80 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_UTIL_MPSC_QUEUE_H_
+#define SABER_UTIL_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+namespace saber {
+
+// An unbounded lock-free multi-producer single-consumer queue. Push is
+// wait-free and may be called from any thread, the others must only be
+// called from the single consumer thread.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(new Node()), tail_(head_.load()) {}
+
+  ~MpscQueue() {
+    T value;
+    while (Pop(&value)) {
+    }
+    delete tail_;
+  }
+
+  void Push(T&& value) {
+    Node* node = new Node(std::move(value));
+    Node* prev = head_.exchange(node);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Return false if the queue is empty, or the next value is being pushed.
+  bool Pop(T* value) {
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return false;
+    }
+    *value = std::move(next->value);
+    delete tail_;
+    tail_ = next;
+    return true;
+  }
+
+  // Pop the values which were pushed before the call, in order.
+  template <typename F>
+  void PopAll(F&& f) {
+    Node* last = head_.load();
+    T value;
+    while (tail_ != last && Pop(&value)) {
+      f(value);
+    }
+  }
+
+  // Unlike Pop, it also returns false when a value is being pushed.
+  bool Empty() const { return head_.load() == tail_; }
+
+ private:
+  struct Node {
+    Node() : next(nullptr) {}
+    explicit Node(T&& v) : next(nullptr), value(std::move(v)) {}
+    std::atomic<Node*> next;
+    T value;
+  };
+
+  // The last pushed node, which is shared by the producers.
+  std::atomic<Node*> head_;
+  // The node whose value has been popped, only used by the consumer. It is
+  // kept on a different cache line from the producers.
+  alignas(64) Node* tail_;
+
+  // No copying allowed
+  MpscQueue(const MpscQueue&);
+  void operator=(const MpscQueue&);
+};
+
+}  // namespace saber
+
+#endif  // SABER_UTIL_MPSC_QUEUE_H_
@@ -27,14 +27,25 @@ Mutex::~Mutex() {
   PthreadCall("pthread_mutex_destory", pthread_mutex_destroy(&mutex_));
 }
 
+static __thread uint64_t wait_micros = 0;
+
 void Mutex::Lock() {
-  PthreadCall("pthread_mutex_lock", pthread_mutex_lock(&mutex_));
+  int result = pthread_mutex_trylock(&mutex_);
+  if (result == EBUSY) {
+    uint64_t start = NowMonotonicMicros();
+    PthreadCall("pthread_mutex_lock", pthread_mutex_lock(&mutex_));
+    wait_micros += NowMonotonicMicros() - start;
+  } else {
+    PthreadCall("pthread_mutex_trylock", result);
+  }
 }
 
 void Mutex::UnLock() {
   PthreadCall("pthread_mutex_unlock", pthread_mutex_unlock(&mutex_));
 }
 
+uint64_t Mutex::WaitMicros() { return wait_micros; }
+
 Condition::Condition(Mutex* mutex) : mutex_(mutex) {
 #ifdef __linux__
   pthread_condattr_t attr;
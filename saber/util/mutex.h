@@ -21,6 +21,10 @@ class Mutex {
   void UnLock();
   void AssertHeld() {}
 
+  // The total time (in microseconds) the calling thread has waited for the
+  // mutexes held by the other threads. Only the contended Lock is timed.
+  static uint64_t WaitMicros();
+
  private:
   friend class Condition;
   pthread_mutex_t mutex_;
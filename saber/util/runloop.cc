@@ -19,6 +19,7 @@ RunLoop::RunLoop()
       tid_(CurrentThread::Tid()),
       mutex_(),
       cond_(&mutex_),
+      sleeping_(false),
       timers_(new TimerList(this)) {}
 
 RunLoop::~RunLoop() {}
@@ -26,28 +27,33 @@ RunLoop::~RunLoop() {}
 void RunLoop::Loop() {
   AssertInMyLoop();
   exit_ = false;
-  std::vector<Func> funcs;
   while (!exit_) {
     uint64_t timeout = timers_->TimeoutMicros();
-    {
+    if (tasks_.Empty()) {
       MutexLock lock(&mutex_);
-      if (funcs_.empty()) {
+      // Pairs with the check of sleeping_ in QueueInLoop, either the
+      // producer sees the loop sleeping or the loop sees the new task.
+      sleeping_.store(true);
+      if (tasks_.Empty() && !exit_) {
         cond_.Wait(timeout);
       }
-      funcs.swap(funcs_);
+      sleeping_.store(false, std::memory_order_relaxed);
     }
     timers_->RunTimerProcs();
-    for (auto& f : funcs) {
-      f();
-    }
-    funcs.clear();
+    // The tasks queued by these tasks will run in the next iteration.
+    tasks_.PopAll([](Task& task) { task(); });
   }
+  // Wait for Exit to release the mutex, the loop may be destroyed soon.
+  MutexLock lock(&mutex_);
 }
 
 void RunLoop::Exit() {
-  exit_ = true;
   if (!IsInMyLoop()) {
+    MutexLock lock(&mutex_);
+    exit_ = true;
     cond_.Signal();
+  } else {
+    exit_ = true;
   }
 }
 
@@ -61,34 +67,22 @@ void RunLoop::AssertInMyLoop() {
   }
 }
 
-void RunLoop::RunInLoop(const Func& func) {
+void RunLoop::RunInLoop(Task task) {
   if (IsInMyLoop()) {
-    func();
+    task();
   } else {
-    QueueInLoop(func);
+    QueueInLoop(std::move(task));
   }
 }
 
-void RunLoop::RunInLoop(Func&& func) {
-  if (IsInMyLoop()) {
-    func();
-  } else {
-    QueueInLoop(std::move(func));
+void RunLoop::QueueInLoop(Task task) {
+  tasks_.Push(std::move(task));
+  if (sleeping_.load()) {
+    MutexLock lock(&mutex_);
+    cond_.Signal();
   }
 }
 
-void RunLoop::QueueInLoop(const Func& func) {
-  MutexLock lock(&mutex_);
-  funcs_.push_back(func);
-  cond_.Signal();
-}
-
-void RunLoop::QueueInLoop(Func&& func) {
-  MutexLock lock(&mutex_);
-  funcs_.push_back(std::move(func));
-  cond_.Signal();
-}
-
 TimerId RunLoop::RunAt(uint64_t micros_value, const TimerProcCallback& cb) {
   return timers_->RunAt(micros_value, cb);
 }
@@ -7,18 +7,22 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <utility>
-#include <vector>
 
+#include "saber/util/mpsc_queue.h"
 #include "saber/util/mutex.h"
+#include "saber/util/task.h"
 
 namespace saber {
 
 class Timer;
 class TimerList;
 
+// The sequence of the timer and the timer itself, the timer may be reused
+// after it has run or been removed.
 typedef std::pair<uint64_t, Timer*> TimerId;
 typedef std::function<void()> TimerProcCallback;
 
@@ -35,10 +39,10 @@ class RunLoop {
   bool IsInMyLoop() const;
   void AssertInMyLoop();
 
-  void RunInLoop(const Func& func);
-  void RunInLoop(Func&& func);
-  void QueueInLoop(const Func& func);
-  void QueueInLoop(Func&& func);
+  // The tasks are queued without any lock, and the loop is only woken up
+  // when it is waiting.
+  void RunInLoop(Task task);
+  void QueueInLoop(Task task);
 
   TimerId RunAt(uint64_t micros_value, const TimerProcCallback& cb);
   TimerId RunAfter(uint64_t micros_delay, const TimerProcCallback& cb);
@@ -51,12 +55,14 @@ class RunLoop {
   void Remove(TimerId t);
 
  private:
-  bool exit_;
+  std::atomic<bool> exit_;
   const uint64_t tid_;
 
   Mutex mutex_;
   Condition cond_;
-  std::vector<Func> funcs_;
+  // Whether the loop is waiting or going to wait on cond_.
+  std::atomic<bool> sleeping_;
+  MpscQueue<Task> tasks_;
   std::unique_ptr<TimerList> timers_;
 
   // No copying allowed
@@ -0,0 +1,132 @@
+// Copyright (c) 2017 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SABER_UTIL_TASK_H_
+#define SABER_UTIL_TASK_H_
+
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace saber {
+
+// A move-only callable of void(). Unlike std::function, the callable whose
+// size is no more than kInlineSize is stored in place without any heap
+// allocation, which covers the lambdas capturing a few pointers and also
+// std::function itself.
+class Task {
+ public:
+  static const size_t kInlineSize = 48;
+
+  Task() : ops_(nullptr) {}
+
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<F>::type, Task>::value>::type>
+  Task(F&& f) : ops_(nullptr) {  // NOLINT
+    typedef typename std::decay<F>::type Callable;
+    Init<Callable>(std::forward<F>(f),
+                   std::integral_constant<
+                       bool, sizeof(Callable) <= kInlineSize &&
+                                 alignof(Callable) <= alignof(Storage)>());
+  }
+
+  Task(Task&& other) : ops_(other.ops_) {
+    if (ops_) {
+      ops_->move(&storage_, &other.storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  Task& operator=(Task&& other) {
+    if (this != &other) {
+      Reset();
+      ops_ = other.ops_;
+      if (ops_) {
+        ops_->move(&storage_, &other.storage_);
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  ~Task() { Reset(); }
+
+  void operator()() { ops_->invoke(&storage_); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+ private:
+  typedef typename std::aligned_storage<kInlineSize>::type Storage;
+
+  struct Ops {
+    void (*invoke)(void* p);
+    // Move the callable from src to the uninitialized dst and destroy src.
+    void (*move)(void* dst, void* src);
+    void (*destroy)(void* p);
+  };
+
+  template <typename Callable>
+  struct InlineOps {
+    static void Invoke(void* p) { (*static_cast<Callable*>(p))(); }
+    static void Move(void* dst, void* src) {
+      new (dst) Callable(std::move(*static_cast<Callable*>(src)));
+      static_cast<Callable*>(src)->~Callable();
+    }
+    static void Destroy(void* p) { static_cast<Callable*>(p)->~Callable(); }
+    static const Ops kOps;
+  };
+
+  template <typename Callable>
+  struct HeapOps {
+    static void Invoke(void* p) { (**static_cast<Callable**>(p))(); }
+    static void Move(void* dst, void* src) {
+      *static_cast<Callable**>(dst) = *static_cast<Callable**>(src);
+    }
+    static void Destroy(void* p) { delete *static_cast<Callable**>(p); }
+    static const Ops kOps;
+  };
+
+  template <typename Callable, typename F>
+  void Init(F&& f, std::true_type) {
+    new (&storage_) Callable(std::forward<F>(f));
+    ops_ = &InlineOps<Callable>::kOps;
+  }
+
+  template <typename Callable, typename F>
+  void Init(F&& f, std::false_type) {
+    *reinterpret_cast<Callable**>(&storage_) = new Callable(std::forward<F>(f));
+    ops_ = &HeapOps<Callable>::kOps;
+  }
+
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  Storage storage_;
+  const Ops* ops_;
+
+  // No copying allowed
+  Task(const Task&);
+  void operator=(const Task&);
+};
+
+template <typename Callable>
+const Task::Ops Task::InlineOps<Callable>::kOps = {
+    &Task::InlineOps<Callable>::Invoke, &Task::InlineOps<Callable>::Move,
+    &Task::InlineOps<Callable>::Destroy};
+
+template <typename Callable>
+const Task::Ops Task::HeapOps<Callable>::kOps = {
+    &Task::HeapOps<Callable>::Invoke, &Task::HeapOps<Callable>::Move,
+    &Task::HeapOps<Callable>::Destroy};
+
+}  // namespace saber
+
+#endif  // SABER_UTIL_TASK_H_
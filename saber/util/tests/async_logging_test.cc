@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "saber/util/async_logging.h"
+#include "saber/util/logging.h"
+#include "saber/util/thread.h"
+
+using namespace saber;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #cond);                                                 \
+      exit(1);                                                        \
+    }                                                                 \
+  } while (0)
+
+static std::string TempPath(const char* name) {
+  char path[256];
+  snprintf(path, sizeof(path), "/tmp/%s.%d", name,
+           static_cast<int>(getpid()));
+  unlink(path);
+  return path;
+}
+
+static std::vector<std::string> ReadLines(const std::string& path) {
+  std::vector<std::string> lines;
+  std::ifstream in(path.c_str());
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// The logs of each thread are written in order, and Flush returns after
+// all of the logs before it are written.
+static void* LogInOrder(void* data) {
+  int from = *reinterpret_cast<int*>(data);
+  for (int i = from; i < from + 1000; ++i) {
+    LOG_INFO("seq %d", i);
+  }
+  return nullptr;
+}
+
+static void TestFlushOrdering() {
+  AsyncLoggingOptions options;
+  options.path = TempPath("async_logging_test_flush");
+  options.rate_limit = 0;
+  AsyncLogging logging(options);
+  CHECK(logging.Start());
+
+  int from[2] = {0, 1000};
+  Thread t1, t2;
+  t1.Start(&LogInOrder, &from[0]);
+  t2.Start(&LogInOrder, &from[1]);
+  t1.Join();
+  t2.Join();
+  logging.Flush();
+
+  std::vector<std::string> lines = ReadLines(options.path);
+  CHECK(lines.size() + logging.DroppedCount() == 2000);
+  int last[2] = {-1, 999};
+  for (auto& line : lines) {
+    const char* p = strstr(line.c_str(), "seq ");
+    CHECK(p != nullptr);
+    int i = atoi(p + 4);
+    int& prev = last[i < 1000 ? 0 : 1];
+    CHECK(i > prev);
+    prev = i;
+  }
+
+  LOG_INFO("after flush");
+  logging.Flush();
+  lines = ReadLines(options.path);
+  CHECK(!lines.empty());
+  CHECK(lines.back().find("after flush") != std::string::npos);
+
+  logging.Stop();
+  unlink(options.path.c_str());
+}
+
+// Every log is either written or counted as dropped.
+static void TestDroppedCount() {
+  AsyncLoggingOptions options;
+  options.path = TempPath("async_logging_test_dropped");
+  options.buffer_size = 1024;
+  options.flush_interval = 1000 * 1000;
+  options.rate_limit = 0;
+  AsyncLogging logging(options);
+  CHECK(logging.Start());
+
+  std::string padding(100, 'x');
+  for (int i = 0; i < 1000; ++i) {
+    LOG_INFO("%d %s", i, padding.c_str());
+  }
+  logging.Flush();
+
+  std::vector<std::string> lines = ReadLines(options.path);
+  CHECK(logging.DroppedCount() > 0);
+  CHECK(lines.size() + logging.DroppedCount() == 1000);
+
+  logging.Stop();
+  unlink(options.path.c_str());
+}
+
+// The suppressed logs are reported by the first log of the next second.
+static void TestRateLimit() {
+  AsyncLoggingOptions options;
+  options.path = TempPath("async_logging_test_rate_limit");
+  options.rate_limit = 10;
+  AsyncLogging logging(options);
+  CHECK(logging.Start());
+
+  for (int i = 0; i < 26; ++i) {
+    if (i == 25) {
+      usleep(1100 * 1000);
+    }
+    LOG_INFO("limited");
+  }
+  logging.Stop();
+
+  std::vector<std::string> lines = ReadLines(options.path);
+  size_t suppressed = 0;
+  for (auto& line : lines) {
+    const char* p = strstr(line.c_str(), " (");
+    if (p != nullptr) {
+      suppressed += static_cast<size_t>(atoi(p + 2));
+    }
+  }
+  CHECK(lines.size() < 26);
+  CHECK(lines.size() + suppressed == 26);
+  unlink(options.path.c_str());
+}
+
+int main() {
+  SetLogLevel(LOGLEVEL_INFO);
+  TestFlushOrdering();
+  TestDroppedCount();
+  TestRateLimit();
+  printf("async_logging_test passed\n");
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "saber/util/countdownlatch.h"
+#include "saber/util/mutexlock.h"
+#include "saber/util/runloop.h"
+#include "saber/util/runloop_thread.h"
+#include "saber/util/timeops.h"
+
+using namespace saber;
+
+// The task queue of RunLoop before it became lock-free, which takes the
+// mutex and signals the condition on every enqueue.
+class LockedLoop {
+ public:
+  typedef std::function<void()> Func;
+
+  LockedLoop() : exit_(false), cond_(&mutex_) {}
+
+  void Loop() {
+    std::vector<Func> funcs;
+    while (true) {
+      {
+        MutexLock lock(&mutex_);
+        while (funcs_.empty() && !exit_) {
+          cond_.Wait();
+        }
+        if (funcs_.empty() && exit_) {
+          return;
+        }
+        funcs.swap(funcs_);
+      }
+      for (auto& f : funcs) {
+        f();
+      }
+      funcs.clear();
+    }
+  }
+
+  void Exit() {
+    MutexLock lock(&mutex_);
+    exit_ = true;
+    cond_.Signal();
+  }
+
+  void QueueInLoop(Func&& func) {
+    MutexLock lock(&mutex_);
+    funcs_.push_back(std::move(func));
+    cond_.Signal();
+  }
+
+ private:
+  bool exit_;
+  Mutex mutex_;
+  Condition cond_;
+  std::vector<Func> funcs_;
+};
+
+struct Counter {
+  explicit Counter(int n) : count(n), sum(0), latch(1) {}
+  int count;
+  uint64_t sum;
+  CountDownLatch latch;
+};
+
+// The capture is larger than the small buffer of std::function, like the
+// most tasks queued by the server.
+template <typename Loop>
+static void Produce(Loop* loop, Counter* counter, int tasks) {
+  uint64_t a = 1, b = 2;
+  for (int i = 0; i < tasks; ++i) {
+    loop->QueueInLoop([counter, a, b]() {
+      counter->sum += a + b;
+      if (--counter->count == 0) {
+        counter->latch.CountDown();
+      }
+    });
+  }
+}
+
+template <typename Loop>
+static void Run(const char* name, Loop* loop, int producers, int tasks) {
+  Counter counter(producers * tasks);
+  uint64_t start = NowMicros();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; ++i) {
+    threads.push_back(std::thread(Produce<Loop>, loop, &counter, tasks));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  counter.latch.Wait();
+  uint64_t micros = NowMicros() - start;
+  printf("%-12s producers=%d tasks=%d time=%.3fs ops/s=%.0f\n", name,
+         producers, producers * tasks,
+         static_cast<double>(micros) / 1000000.0,
+         producers * tasks * 1000000.0 /
+             static_cast<double>(micros > 0 ? micros : 1));
+}
+
+int main(int argc, char** argv) {
+  int producers = argc > 1 ? atoi(argv[1]) : 4;
+  int tasks = argc > 2 ? atoi(argv[2]) : 1000000;
+
+  {
+    LockedLoop loop;
+    std::thread thread([&loop]() { loop.Loop(); });
+    Run("locked", &loop, producers, tasks);
+    loop.Exit();
+    thread.join();
+  }
+  {
+    RunLoopThread thread;
+    RunLoop* loop = thread.Loop();
+    Run("runloop", loop, producers, tasks);
+  }
+  return 0;
+}
@@ -1,16 +1,127 @@
-#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "saber/util/runloop.h"
+#include "saber/util/timeops.h"
 
-using namespace std;
 using namespace saber;
 
-int main() {
+// The timers of TimerList before the timing wheel, which are kept in two
+// sets ordered by the expiration and the address.
+class SetTimers {
+ public:
+  struct Timer {
+    uint64_t micros_value;
+    TimerProcCallback timerproc_cb;
+  };
+  typedef std::pair<uint64_t, Timer*> Id;
+
+  ~SetTimers() {
+    for (auto& t : timer_ptrs_) {
+      delete t;
+    }
+  }
+
+  Id RunAfter(uint64_t micros_delay, const TimerProcCallback& cb) {
+    uint64_t micros_value = NowMicros() + micros_delay;
+    Id timer(micros_value, new Timer{micros_value, cb});
+    timers_.insert(timer);
+    timer_ptrs_.insert(timer.second);
+    return timer;
+  }
+
+  void Remove(Id timer) {
+    if (timer_ptrs_.erase(timer.second) > 0) {
+      timers_.erase(timer);
+      delete timer.second;
+    }
+  }
+
+ private:
+  std::set<Timer*> timer_ptrs_;
+  std::set<Id> timers_;
+};
+
+static void Report(const char* name, int timers, uint64_t micros) {
+  printf("%-24s timers=%d time=%.3fs ops/s=%.0f\n", name, timers,
+         static_cast<double>(micros) / 1000000.0,
+         timers * 1000000.0 / static_cast<double>(micros > 0 ? micros : 1));
+}
+
+// Add the timers with the delays up to ten minutes, then remove them.
+template <typename Timers, typename Id>
+static void AddAndRemove(const char* name, Timers* t,
+                         const std::vector<uint64_t>& delays) {
+  std::vector<Id> ids;
+  ids.reserve(delays.size());
+  int size = static_cast<int>(delays.size());
+  uint64_t start = NowMonotonicMicros();
+  for (auto& delay : delays) {
+    ids.push_back(t->RunAfter(delay, []() {}));
+  }
+  uint64_t middle = NowMonotonicMicros();
+  for (auto& id : ids) {
+    t->Remove(id);
+  }
+  uint64_t end = NowMonotonicMicros();
+  std::string s(name);
+  Report((s + " add").c_str(), size, middle - start);
+  Report((s + " remove").c_str(), size, end - middle);
+}
+
+int main(int argc, char** argv) {
+  int timers = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  std::mt19937_64 rand(0);
+  std::vector<uint64_t> delays;
+  for (int i = 0; i < timers; ++i) {
+    delays.push_back(rand() % (600 * 1000 * 1000));
+  }
+
   RunLoop loop;
-  loop.RunEvery(10 * 1000 * 1000, []() {
-    static int i = 0;
-    cout << "test " << i++ << endl;
-  });
+  {
+    SetTimers t;
+    AddAndRemove<SetTimers, SetTimers::Id>("set", &t, delays);
+  }
+  AddAndRemove<RunLoop, TimerId>("wheel", &loop, delays);
+  // The timer nodes have been freed, so they are reused now.
+  AddAndRemove<RunLoop, TimerId>("wheel (reused)", &loop, delays);
+
+  // Run the timers with the delays up to one second, and check that none
+  // of them runs earlier than expected.
+  int fired = 0;
+  int early = 0;
+  uint64_t late = 0;
+  uint64_t max_late = 0;
+  uint64_t start = NowMonotonicMicros();
+  for (int i = 0; i < timers; ++i) {
+    uint64_t delay = delays[i] % (1000 * 1000);
+    uint64_t expected = NowMonotonicMicros() + delay;
+    loop.RunAfter(delay, [&, expected]() {
+      uint64_t now = NowMonotonicMicros();
+      if (now < expected) {
+        ++early;
+      } else {
+        late += now - expected;
+        if (now - expected > max_late) {
+          max_late = now - expected;
+        }
+      }
+      if (++fired == timers) {
+        loop.Exit();
+      }
+    });
+  }
   loop.Loop();
-  return 0;
+  Report("wheel run", timers, NowMonotonicMicros() - start);
+  printf("early=%d avg_late=%.0fus max_late=%lluus\n", early,
+         static_cast<double>(late) / timers,
+         static_cast<unsigned long long>(max_late));
+  return early == 0 ? 0 : 1;
 }
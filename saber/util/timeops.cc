@@ -23,6 +23,16 @@ uint64_t NowMicros() {
   return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
 }
 
+uint64_t NowMonotonicMicros() {
+#ifdef __linux__
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+  return NowMicros();
+#endif
+}
+
 void SleepForMicroseconds(int micros) { usleep(micros); }
 
 }  // namespace saber
@@ -13,6 +13,10 @@ extern uint64_t NowMillis();
 
 extern uint64_t NowMicros();
 
+// Unlike NowMicros, it never goes backwards when the system time changes,
+// which should be used to measure the elapsed time.
+extern uint64_t NowMonotonicMicros();
+
 extern void SleepForMicroseconds(int micros);
 
 }  // namespace saber
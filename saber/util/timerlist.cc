@@ -8,152 +8,293 @@
 
 namespace saber {
 
-class Timer {
+class Timer : public TimerList::Link {
  private:
   friend class TimerList;
 
-  Timer(uint64_t value, uint64_t interval, const TimerProcCallback& cb)
-      : micros_value(value), micros_interval(interval), timerproc_cb(cb) {}
-
-  Timer(uint64_t value, uint64_t interval, TimerProcCallback&& cb)
-      : micros_value(value),
-        micros_interval(interval),
-        timerproc_cb(std::move(cb)) {}
+  Timer() : seq(0), micros_value(0), micros_interval(0), slot(-1) {
+    prev = next = nullptr;
+  }
 
   ~Timer() {}
 
+  // Zero if the timer is free.
+  uint64_t seq;
   uint64_t micros_value;
   uint64_t micros_interval;
+  // The index in root_, or -1 if the timer is in the higher wheels.
+  int slot;
   TimerProcCallback timerproc_cb;
 };
 
 TimerList::TimerList(RunLoop* loop)
-    : last_time_out_(NowMicros()), loop_(loop) {}
+    : loop_(loop),
+      current_(NowMonotonicMicros() / kTickMicros),
+      size_(0),
+      seq_(0),
+      running_(nullptr) {
+  for (uint64_t i = 0; i < kRootSize; ++i) {
+    root_[i].Init();
+  }
+  for (uint64_t i = 0; i < kRootSize / 64; ++i) {
+    root_bits_[i] = 0;
+  }
+  for (int level = 0; level < kLevels; ++level) {
+    for (uint64_t i = 0; i < kLevelSize; ++i) {
+      levels_[level][i].Init();
+    }
+  }
+}
 
 TimerList::~TimerList() {
-  for (auto& t : timer_ptrs_) {
+  std::vector<Link*> slots;
+  for (uint64_t i = 0; i < kRootSize; ++i) {
+    slots.push_back(&root_[i]);
+  }
+  for (int level = 0; level < kLevels; ++level) {
+    for (uint64_t i = 0; i < kLevelSize; ++i) {
+      slots.push_back(&levels_[level][i]);
+    }
+  }
+  for (auto& slot : slots) {
+    while (!slot->Empty()) {
+      Timer* t = static_cast<Timer*>(slot->next);
+      Unlink(t);
+      delete t;
+    }
+  }
+  for (auto& t : free_timers_) {
     delete t;
   }
 }
 
 TimerId TimerList::RunAt(uint64_t micros_value, const TimerProcCallback& cb) {
-  TimerId timer(micros_value, new Timer(micros_value, 0, cb));
-  InsertInLoop(timer);
-  return timer;
+  uint64_t now = NowMicros();
+  return Add(micros_value > now ? micros_value - now : 0, 0,
+             TimerProcCallback(cb));
 }
 
 TimerId TimerList::RunAt(uint64_t micros_value, TimerProcCallback&& cb) {
-  TimerId timer(micros_value, new Timer(micros_value, 0, std::move(cb)));
-  InsertInLoop(timer);
-  return timer;
+  uint64_t now = NowMicros();
+  return Add(micros_value > now ? micros_value - now : 0, 0, std::move(cb));
 }
 
 TimerId TimerList::RunAfter(uint64_t micros_delay,
                             const TimerProcCallback& cb) {
-  uint64_t micros_value = NowMicros() + micros_delay;
-  TimerId timer(micros_value, new Timer(micros_value, 0, cb));
-  InsertInLoop(timer);
-  return timer;
+  return Add(micros_delay, 0, TimerProcCallback(cb));
 }
 
 TimerId TimerList::RunAfter(uint64_t micros_delay, TimerProcCallback&& cb) {
-  uint64_t micros_value = NowMicros() + micros_delay;
-  TimerId timer(micros_value, new Timer(micros_value, 0, std::move(cb)));
-  InsertInLoop(timer);
-  return timer;
+  return Add(micros_delay, 0, std::move(cb));
 }
 
 TimerId TimerList::RunEvery(uint64_t micros_interval,
                             const TimerProcCallback& cb) {
-  uint64_t micros_value = NowMicros() + micros_interval;
-  TimerId timer(micros_value, new Timer(micros_value, micros_interval, cb));
-  InsertInLoop(timer);
-  return timer;
+  return Add(micros_interval, micros_interval, TimerProcCallback(cb));
 }
 
 TimerId TimerList::RunEvery(uint64_t micros_interval, TimerProcCallback&& cb) {
-  uint64_t micros_value = NowMicros() + micros_interval;
-  TimerId timer(micros_value,
-                new Timer(micros_value, micros_interval, std::move(cb)));
-  InsertInLoop(timer);
-  return timer;
+  return Add(micros_interval, micros_interval, std::move(cb));
 }
 
 void TimerList::Remove(TimerId timer) {
-  loop_->RunInLoop([timer, this]() mutable {
-    if (timer_ptrs_.find(timer.second) != timer_ptrs_.end()) {
-      timer_ptrs_.erase(timer.second);
-      timer.first = timer.second->micros_value;
-      delete timer.second;
-      timers_.erase(timer);
+  if (loop_->IsInMyLoop()) {
+    RemoveInLoop(timer);
+  } else {
+    loop_->QueueInLoop([this, timer]() { RemoveInLoop(timer); });
+  }
+}
+
+TimerId TimerList::Add(uint64_t micros_delay, uint64_t micros_interval,
+                       TimerProcCallback&& cb) {
+  uint64_t micros_value = NowMonotonicMicros() + micros_delay;
+  bool in_loop = loop_->IsInMyLoop();
+  // The free timers are only used in the loop.
+  Timer* t = in_loop ? NewTimer() : new Timer();
+  t->seq = seq_.fetch_add(1, std::memory_order_relaxed) + 1;
+  t->micros_value = micros_value;
+  t->micros_interval = micros_interval;
+  t->timerproc_cb = std::move(cb);
+  TimerId timer(t->seq, t);
+  if (in_loop) {
+    Insert(t);
+  } else {
+    loop_->QueueInLoop([this, t]() { Insert(t); });
+  }
+  return timer;
+}
+
+Timer* TimerList::NewTimer() {
+  if (free_timers_.empty()) {
+    return new Timer();
+  }
+  Timer* t = free_timers_.back();
+  free_timers_.pop_back();
+  return t;
+}
+
+void TimerList::FreeTimer(Timer* t) {
+  t->seq = 0;
+  t->timerproc_cb = nullptr;
+  free_timers_.push_back(t);
+}
+
+void TimerList::Insert(Timer* t) {
+  if (size_ == 0) {
+    // The ticks may not be run for a long time without any timers.
+    uint64_t tick = NowMonotonicMicros() / kTickMicros;
+    if (current_ < tick) {
+      current_ = tick;
     }
-  });
+  }
+  // Round up, so that the timer never runs earlier than expected.
+  uint64_t tick = (t->micros_value + kTickMicros - 1) / kTickMicros;
+  if (tick < current_) {
+    tick = current_;
+  }
+  uint64_t delta = tick - current_;
+  Link* slot;
+  if (delta < kRootSize) {
+    t->slot = static_cast<int>(tick & (kRootSize - 1));
+    root_bits_[t->slot / 64] |= 1ULL << (t->slot % 64);
+    slot = &root_[t->slot];
+  } else {
+    t->slot = -1;
+    int level = 0;
+    uint64_t limit = kRootSize << kLevelBits;
+    while (level < kLevels - 1 && delta >= limit) {
+      ++level;
+      limit <<= kLevelBits;
+    }
+    if (delta >= limit) {
+      // Too far away, it will be inserted again when cascaded.
+      tick = current_ + limit - 1;
+    }
+    int shift = kRootBits + level * kLevelBits;
+    slot = &levels_[level][(tick >> shift) & (kLevelSize - 1)];
+  }
+  slot->PushBack(t);
+  ++size_;
 }
 
-void TimerList::InsertInLoop(TimerId timer) {
-  loop_->RunInLoop([timer, this]() {
-    timers_.insert(timer);
-    timer_ptrs_.insert(timer.second);
-  });
+void TimerList::Unlink(Timer* t) {
+  t->prev->next = t->next;
+  t->next->prev = t->prev;
+  t->prev = t->next = nullptr;
+  if (t->slot >= 0 && root_[t->slot].Empty()) {
+    root_bits_[t->slot / 64] &= ~(1ULL << (t->slot % 64));
+  }
+  --size_;
+}
+
+void TimerList::Cascade(Link* slot) {
+  Link timers;
+  timers.Init();
+  slot->MoveTo(&timers);
+  while (!timers.Empty()) {
+    Timer* t = static_cast<Timer*>(timers.next);
+    Unlink(t);
+    Insert(t);
+  }
+}
+
+void TimerList::RemoveInLoop(TimerId timer) {
+  Timer* t = timer.second;
+  if (timer.first == 0 || t->seq != timer.first || t->prev == nullptr) {
+    return;
+  }
+  Unlink(t);
+  // The running timer will be freed after its callback returns.
+  if (t != running_) {
+    FreeTimer(t);
+  }
+}
+
+uint64_t TimerList::NextTick() const {
+  uint64_t index = current_ & (kRootSize - 1);
+  uint64_t base = current_ - index;
+  if (index == 0) {
+    return current_;
+  }
+  for (uint64_t i = index / 64; i < kRootSize / 64; ++i) {
+    uint64_t bits = root_bits_[i];
+    if (i == index / 64) {
+      bits &= ~0ULL << (index % 64);
+    }
+    if (bits != 0) {
+      return base + i * 64 + static_cast<uint64_t>(__builtin_ctzll(bits));
+    }
+  }
+  return base + kRootSize;
 }
 
 uint64_t TimerList::TimeoutMicros() const {
   loop_->AssertInMyLoop();
-  if (timers_.empty()) {
+  if (size_ == 0) {
     return -1;
   }
-  std::set<TimerId>::const_iterator it = timers_.begin();
-  uint64_t now = NowMicros();
-  if (now < last_time_out_) {
-    return 0;
-  }
-  if (it->first <= now) {
-    return 0;
-  } else {
-    return (it->first - now);
-  }
+  uint64_t micros_value = NextTick() * kTickMicros;
+  uint64_t now = NowMonotonicMicros();
+  return micros_value > now ? micros_value - now : 0;
 }
 
 void TimerList::RunTimerProcs() {
   loop_->AssertInMyLoop();
-  if (timers_.empty()) {
+  if (size_ == 0) {
     return;
   }
 
-  uint64_t micros_now = NowMicros();
+  uint64_t micros_now = NowMonotonicMicros();
+  uint64_t target = micros_now / kTickMicros;
 
-  if (micros_now < last_time_out_) {
-    uint64_t diff = last_time_out_ - micros_now;
-    std::set<TimerId> timers;
-    for (auto& it : timers_) {
-      uint64_t value = it.first > diff ? it.first - diff : 0;
-      it.second->micros_value = value;
-      timers.insert(TimerId(value, it.second));
+  while (size_ > 0) {
+    uint64_t tick = NextTick();
+    if (tick > target) {
+      break;
+    }
+    current_ = tick;
+    uint64_t index = tick & (kRootSize - 1);
+    if (index == 0) {
+      for (int level = 0; level < kLevels; ++level) {
+        int shift = kRootBits + level * kLevelBits;
+        uint64_t i = (tick >> shift) & (kLevelSize - 1);
+        Cascade(&levels_[level][i]);
+        if (i != 0) {
+          break;
+        }
+      }
     }
-    timers_.swap(timers);
-  }
-  last_time_out_ = micros_now;
 
-  std::set<TimerId>::iterator it;
-  while (true) {
-    it = timers_.begin();
-    if (it != timers_.end() && it->first <= micros_now) {
-      Timer* t = it->second;
-      timers_.erase(it);
-      TimerProcCallback cb = t->timerproc_cb;
+    Link expired;
+    expired.Init();
+    root_[index].MoveTo(&expired);
+    root_bits_[index / 64] &= ~(1ULL << (index % 64));
+    current_ = tick + 1;
+
+    while (!expired.Empty()) {
+      Timer* t = static_cast<Timer*>(expired.next);
+      Unlink(t);
       if (t->micros_interval > 0) {
         t->micros_value = micros_now + t->micros_interval;
-        TimerId timer(t->micros_value, t);
-        timers_.insert(timer);
+        Insert(t);
+        running_ = t;
+        t->timerproc_cb();
+        running_ = nullptr;
+        if (t->prev == nullptr) {
+          FreeTimer(t);
+        }
       } else {
-        delete t;
-        timer_ptrs_.erase(t);
+        TimerProcCallback cb(std::move(t->timerproc_cb));
+        FreeTimer(t);
+        cb();
       }
-      cb();
-    } else {
-      break;
     }
   }
+
+  // No timers are in the ticks up to the target.
+  if (current_ <= target) {
+    current_ = target + 1;
+  }
 }
 
 }  // namespace saber
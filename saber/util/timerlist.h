@@ -6,19 +6,29 @@
 #define SABER_UTIL_TIMERLIST_H_
 
 #include <stdint.h>
+
+#include <atomic>
 #include <functional>
-#include <set>
 #include <utility>
+#include <vector>
 
 #include "saber/util/runloop.h"
 
 namespace saber {
 
+// A hierarchical timing wheel with the resolution of kTickMicros. Timers
+// are kept in the doubly-linked slots, so both inserting and removing are
+// O(1), and the timers far away are cascaded into the lower wheels when
+// the time passes. The timer nodes are reused, and all the times are on
+// the monotonic clock.
 class TimerList {
  public:
+  static const uint64_t kTickMicros = 1000;
+
   explicit TimerList(RunLoop* loop);
   ~TimerList();
 
+  // The micros_value is the wall-clock time, as NowMicros.
   TimerId RunAt(uint64_t micros_value, const TimerProcCallback& cb);
   TimerId RunAt(uint64_t micros_value, TimerProcCallback&& cb);
 
@@ -34,13 +44,65 @@ class TimerList {
   void RunTimerProcs();
 
  private:
-  void InsertInLoop(TimerId timer);
-
-  uint64_t last_time_out_;
+  friend class Timer;
+
+  static const int kRootBits = 8;
+  static const int kLevelBits = 6;
+  static const int kLevels = 3;
+  static const uint64_t kRootSize = 1 << kRootBits;
+  static const uint64_t kLevelSize = 1 << kLevelBits;
+
+  struct Link {
+    void Init() { prev = next = this; }
+    bool Empty() const { return next == this; }
+    void PushBack(Link* link) {
+      link->prev = prev;
+      link->next = this;
+      prev->next = link;
+      prev = link;
+    }
+    // Move all the links to the empty list.
+    void MoveTo(Link* list) {
+      if (Empty()) {
+        return;
+      }
+      list->next = next;
+      list->prev = prev;
+      next->prev = list;
+      prev->next = list;
+      Init();
+    }
+
+    Link* prev;
+    Link* next;
+  };
+
+  TimerId Add(uint64_t micros_delay, uint64_t micros_interval,
+              TimerProcCallback&& cb);
+  Timer* NewTimer();
+  void FreeTimer(Timer* t);
+
+  void Insert(Timer* t);
+  void Unlink(Timer* t);
+  void Cascade(Link* slot);
+  void RemoveInLoop(TimerId timer);
+
+  // The next tick which has timers to run or to cascade.
+  uint64_t NextTick() const;
 
   RunLoop* loop_;
-  std::set<Timer*> timer_ptrs_;
-  std::set<TimerId> timers_;
+
+  // The next tick to run, the ticks before it have been run.
+  uint64_t current_;
+  size_t size_;
+  Link root_[kRootSize];
+  // Which slots of root_ have timers.
+  uint64_t root_bits_[kRootSize / 64];
+  Link levels_[kLevels][kLevelSize];
+
+  std::atomic<uint64_t> seq_;
+  std::vector<Timer*> free_timers_;
+  Timer* running_;
 
   // No copying allowed
   TimerList(const TimerList&);